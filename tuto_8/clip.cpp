@@ -0,0 +1,105 @@
+#include <cmath>
+#include "clip.h"
+
+const int NPLANES = 5;
+
+// Distance signée (positive à l'intérieur) de v au plan proche puis aux quatre bords
+// de la bande de garde, par exemple x/w >= -GUARD_BAND s'écrit x + GUARD_BAND*w >= 0 quand w > 0.
+// Le plan proche est traité en premier : les plans suivants ne voient que des sommets où w > 0.
+static float plane_distance(int plane, const ClipVertex &v, int width, int height) {
+    switch (plane) {
+        case 0:  return v.w - NEAR_W;
+        case 1:  return v.x + GUARD_BAND*v.w;
+        case 2:  return (width + GUARD_BAND)*v.w - v.x;
+        case 3:  return v.y + GUARD_BAND*v.w;
+        default: return (height + GUARD_BAND)*v.w - v.y;
+    }
+}
+
+static Vec3f divide(const ClipVertex &v) {
+    return Vec3f(v.x/v.w, v.y/v.w, v.z/v.w);
+}
+
+// Sommet du polygone en cours de découpage et ses barycentriques dans la face
+struct PolyVertex {
+    ClipVertex v;
+    Vec3f bar;
+};
+
+static PolyVertex lerp(const PolyVertex &a, const PolyVertex &b, float t) {
+    PolyVertex r;
+    r.v.x = a.v.x + (b.v.x - a.v.x)*t;
+    r.v.y = a.v.y + (b.v.y - a.v.y)*t;
+    r.v.z = a.v.z + (b.v.z - a.v.z)*t;
+    r.v.w = a.v.w + (b.v.w - a.v.w)*t;
+    r.bar = a.bar + (b.bar - a.bar)*t;
+    return r;
+}
+
+void ClippedFaces::clip(const Model *model, const std::vector<ClipVertex> &corners, const std::vector<bool> &face_visible,
+                        int width, int height, std::vector<Vec3f> &screen_verts) {
+    const int nfaces = model->nfaces();
+    first_.assign(nfaces + 1, 0);
+    clipped_.assign(nfaces, false);
+    triangles_.clear();
+    inv_w_.assign(3*nfaces, 1.f);
+    screen_verts.resize(corners.size());
+    std::vector<PolyVertex> poly, next;
+    for (int f = 0; f < nfaces; f++) {
+        first_[f] = (int)triangles_.size();
+        if (!face_visible[f]) continue;
+        const ClipVertex *v = &corners[model->face_offset(f)];
+
+        // Plans traversés par la face : aucun dans le cas courant, la face est seulement divisée par w
+        int outside = 0;
+        for (int p = 0; p < NPLANES; p++)
+            for (int j = 0; j < 3; j++)
+                if (plane_distance(p, v[j], width, height) < 0) outside |= 1 << p;
+        if (!outside) {
+            for (int j = 0; j < 3; j++) {
+                screen_verts[model->face_offset(f) + j] = divide(v[j]);
+                inv_w_[3*f + j] = 1.f/v[j].w;
+            }
+            continue;
+        }
+
+        clipped_[f] = true;
+        poly.clear();
+        for (int j = 0; j < 3; j++) {
+            PolyVertex pv;
+            pv.v = v[j];
+            pv.bar = Vec3f(j == 0, j == 1, j == 2);
+            poly.push_back(pv);
+        }
+        for (int p = 0; p < NPLANES && poly.size() >= 3; p++) {
+            if (!(outside & (1 << p))) continue;
+            next.clear();
+            for (size_t i = 0; i < poly.size(); i++) {
+                const PolyVertex &a = poly[i], &b = poly[(i+1) % poly.size()];
+                float da = plane_distance(p, a.v, width, height), db = plane_distance(p, b.v, width, height);
+                if (da >= 0) next.push_back(a);
+                if ((da >= 0) != (db >= 0)) next.push_back(lerp(a, b, da/(da - db)));
+            }
+            poly.swap(next);
+        }
+        if (poly.size() < 3) continue; // face entièrement hors du volume
+
+        for (size_t i = 1; i + 1 < poly.size(); i++) {
+            ClipTriangle t;
+            const PolyVertex *fan[3] = { &poly[0], &poly[i], &poly[i+1] };
+            for (int j = 0; j < 3; j++) {
+                t.pts[j] = divide(fan[j]->v);
+                t.bar[j] = fan[j]->bar;
+                t.inv_w[j] = 1.f/fan[j]->v.w;
+            }
+            triangles_.push_back(t);
+        }
+    }
+    first_[nfaces] = (int)triangles_.size();
+}
+
+int ClippedFaces::nclipped() const {
+    int n = 0;
+    for (bool c : clipped_) n += c;
+    return n;
+}
@@ -0,0 +1,48 @@
+#ifndef __CLIP_H__
+#define __CLIP_H__
+
+#include <vector>
+#include "geometry.h"
+#include "model.h"
+
+// Sommet après la matrice monde -> écran, avant la division perspective
+struct ClipVertex {
+    float x, y, z, w;
+};
+
+// Bande de garde : un triangle qui dépasse de l'écran de moins de GUARD_BAND pixels n'est pas découpé,
+// la rastérisation se limite déjà à l'écran. Au-delà, les coordonnées en virgule fixe 24.8 et les
+// plans des barycentriques perdraient leur précision.
+const float GUARD_BAND = 8192.f;
+// Plan proche : w >= NEAR_W (w s'annule au plan de la caméra). Il n'y a pas de plan lointain : z ne sert
+// qu'au z-buffer, qui part de INT_MIN et accepte toute profondeur.
+const float NEAR_W = 1e-2f;
+
+// Triangle issu du découpage d'une face : sommets écran, leur 1/w et les poids de chacun dans la face
+// (en coordonnées homogènes, le sommet découpé vaut bar.x*A + bar.y*B + bar.z*C)
+struct ClipTriangle {
+    Vec3f pts[3];
+    Vec3f bar[3];
+    float inv_w[3];
+};
+
+// Etage de découpage en coordonnées homogènes. Les faces entièrement devant le plan proche et dans la bande
+// de garde sont simplement divisées par w ; seules les autres sont découpées par les plans qu'elles traversent (Sutherland-Hodgman), en un éventail de triangles.
+class ClippedFaces {
+    std::vector<int> first_; // triangles de la face f : [first_[f], first_[f+1]) si clipped_[f]
+    std::vector<bool> clipped_;
+    std::vector<ClipTriangle> triangles_;
+    std::vector<float> inv_w_; // 1/w des trois premiers coins de chaque face non découpée
+public:
+    // corners : coins des faces (Model::face_offset) en coordonnées homogènes, écran de width x height pixels.
+    // Remplit screen_verts pour les faces non découpées, les faces non visibles sont ignorées.
+    void clip(const Model *model, const std::vector<ClipVertex> &corners, const std::vector<bool> &face_visible,
+              int width, int height, std::vector<Vec3f> &screen_verts);
+    bool is_clipped(int face) const { return clipped_[face]; }
+    const float *inv_w(int face) const { return &inv_w_[3*face]; }
+    const ClipTriangle *begin(int face) const { return triangles_.data() + first_[face]; }
+    const ClipTriangle *end(int face) const { return triangles_.data() + first_[face+1]; }
+    int nclipped() const;
+};
+
+#endif //__CLIP_H__
@@ -0,0 +1,34 @@
+#include <cmath>
+#include "culling.h"
+
+// x/w >= 0 s'écrit ligne0.p >= 0, x/w <= width s'écrit (width*ligne3 - ligne0).p >= 0, etc.
+Frustum::Frustum(const Matrix &m, int width, int height) {
+    for (int j = 0; j < 4; j++) {
+        planes[0][j] = m[0][j];
+        planes[1][j] = width*m[3][j] - m[0][j];
+        planes[2][j] = m[1][j];
+        planes[3][j] = height*m[3][j] - m[1][j];
+        planes[4][j] = m[3][j];
+    }
+    // Normales unitaires pour comparer la distance au rayon
+    for (int i = 0; i < 5; i++) {
+        float n = std::sqrt(planes[i][0]*planes[i][0] + planes[i][1]*planes[i][1] + planes[i][2]*planes[i][2]);
+        if (n > 0) for (int j = 0; j < 4; j++) planes[i][j] /= n;
+    }
+}
+
+bool Frustum::sphere_visible(Vec3f center, float radius) const {
+    for (int i = 0; i < 5; i++)
+        if (planes[i][0]*center.x + planes[i][1]*center.y + planes[i][2]*center.z + planes[i][3] < -radius) return false;
+    return true;
+}
+
+bool cone_backfacing(const Meshlet &meshlet, Vec3f eye) {
+    Vec3f view = meshlet.center - eye;
+    return view * meshlet.cone_axis >= meshlet.cone_cutoff * view.norm() + meshlet.radius;
+}
+
+bool cone_frontfacing(const Meshlet &meshlet, Vec3f eye) {
+    Vec3f view = meshlet.center - eye;
+    return -(view * meshlet.cone_axis) >= meshlet.cone_cutoff * view.norm() + meshlet.radius;
+}
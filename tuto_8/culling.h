@@ -0,0 +1,22 @@
+#ifndef __CULLING_H__
+#define __CULLING_H__
+
+#include "geometry.h"
+#include "model.h"
+
+// Tronc de vue d'une matrice monde -> écran (division perspective comprise) sur un écran de
+// width x height pixels : plans gauche, droit, bas, haut et plan de la caméra (w > 0)
+class Frustum {
+    float planes[5][4];
+public:
+    Frustum(const Matrix &m, int width, int height);
+    // false si la sphère est entièrement hors du tronc
+    bool sphere_visible(Vec3f center, float radius) const;
+};
+
+// true si toutes les faces du meshlet sont vues de dos depuis eye
+bool cone_backfacing(const Meshlet &meshlet, Vec3f eye);
+// true si toutes les faces du meshlet sont vues de face depuis eye (même test, cône retourné)
+bool cone_frontfacing(const Meshlet &meshlet, Vec3f eye);
+
+#endif //__CULLING_H__
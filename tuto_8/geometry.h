@@ -2,13 +2,13 @@
 #define __GEOMETRY_H__
 
 #include <cmath>
-#include <vector>
+#include <cassert>
+#include <ostream>
 
-class Matrix;
+template <int R, int C> class Mat;
 
 template <class t> struct Vec2 {
     t x, y;
-    t raw[2];
     Vec2<t>() : x(t()), y(t()) {}
     Vec2<t>(t _x, t _y) : x(_x), y(_y) {}
     Vec2<t> operator +(const Vec2<t> &V) const { return Vec2<t>(x+V.x, y+V.y); }
@@ -20,10 +20,9 @@ template <class t> struct Vec2 {
 
 template <class t> struct Vec3 {
     t x, y, z;
-    t raw[3];
     Vec3<t>() : x(t()), y(t()), z(t()) { }
     Vec3<t>(t _x, t _y, t _z) : x(_x), y(_y), z(_z) {}
-    Vec3<t>(Matrix m);
+    Vec3<t>(const Mat<4,1> &m);
     template <class u> Vec3<t>(const Vec3<u> &v);
     Vec3<t> operator ^(const Vec3<t> &v) const { return Vec3<t>(y*v.z-z*v.y, z*v.x-x*v.z, x*v.y-y*v.x); }
     Vec3<t> operator +(const Vec3<t> &v) const { return Vec3<t>(x+v.x, y+v.y, z+v.z); }
@@ -57,21 +56,173 @@ template <class t> std::ostream& operator<<(std::ostream& s, Vec3<t>& v) {
 
 //////////////////////////////////////////////////////////////////////////////////////////////
 
-class Matrix {
-    std::vector<std::vector<float> > m;
-    int rows, cols;
+template <int R, int C> class Mat {
+    float m[R][C];
 public:
-    Matrix(int r=4, int c=4);
-    Matrix(Vec3f v);
-    int nrows();
-    int ncols();
-    static Matrix identity(int dimensions);
-    std::vector<float>& operator[](const int i);
-    Matrix operator*(const Matrix& a);
-    Matrix transpose();
-    Matrix inverse();
-    friend std::ostream& operator<<(std::ostream& s, Matrix& m);
+    Mat();
+    Mat(Vec3f v);
+    int nrows() const { return R; }
+    int ncols() const { return C; }
+    static Mat<R,C> identity();
+    float* operator[](const int i)             { assert(i>=0 && i<R); return m[i]; }
+    const float* operator[](const int i) const { assert(i>=0 && i<R); return m[i]; }
+    template <int K> Mat<R,K> operator*(const Mat<C,K>& a) const;
+    Mat<C,R> transpose() const;
+    Mat<R,C> inverse() const;
 };
 
+// Les matrices sont stockées sur la pile : aucune allocation dans le pipeline des sommets
+typedef Mat<4,4> Mat4;
+typedef Mat<4,1> Vec4;
+typedef Mat4     Matrix;
+
+template <int R, int C> Mat<R,C>::Mat() {
+    for (int i=0; i<R; i++)
+        for (int j=0; j<C; j++)
+            m[i][j] = 0.f;
+}
+
+template <> inline Mat<4,1>::Mat(Vec3f v) {
+    m[0][0] = v.x;
+    m[1][0] = v.y;
+    m[2][0] = v.z;
+    m[3][0] = 1.f;
+}
+
+template <int R, int C> Mat<R,C> Mat<R,C>::identity() {
+    Mat<R,C> E;
+    for (int i=0; i<R && i<C; i++)
+        E.m[i][i] = 1.f;
+    return E;
+}
+
+template <int R, int C> template <int K> Mat<R,K> Mat<R,C>::operator*(const Mat<C,K>& a) const {
+    Mat<R,K> result;
+    for (int i=0; i<R; i++) {
+        for (int j=0; j<K; j++) {
+            float s = 0.f;
+            for (int k=0; k<C; k++)
+                s += m[i][k]*a[k][j];
+            result[i][j] = s;
+        }
+    }
+    return result;
+}
+
+// Produits 4x4*4x4 et 4x4*4x1 déroulés à la main
+template <> template <> inline Mat4 Mat4::operator*<4>(const Mat4& a) const {
+    Mat4 result;
+    for (int i=0; i<4; i++) {
+        result.m[i][0] = m[i][0]*a.m[0][0] + m[i][1]*a.m[1][0] + m[i][2]*a.m[2][0] + m[i][3]*a.m[3][0];
+        result.m[i][1] = m[i][0]*a.m[0][1] + m[i][1]*a.m[1][1] + m[i][2]*a.m[2][1] + m[i][3]*a.m[3][1];
+        result.m[i][2] = m[i][0]*a.m[0][2] + m[i][1]*a.m[1][2] + m[i][2]*a.m[2][2] + m[i][3]*a.m[3][2];
+        result.m[i][3] = m[i][0]*a.m[0][3] + m[i][1]*a.m[1][3] + m[i][2]*a.m[2][3] + m[i][3]*a.m[3][3];
+    }
+    return result;
+}
+
+template <> template <> inline Vec4 Mat4::operator*<1>(const Vec4& a) const {
+    Vec4 result;
+    result[0][0] = m[0][0]*a[0][0] + m[0][1]*a[1][0] + m[0][2]*a[2][0] + m[0][3]*a[3][0];
+    result[1][0] = m[1][0]*a[0][0] + m[1][1]*a[1][0] + m[1][2]*a[2][0] + m[1][3]*a[3][0];
+    result[2][0] = m[2][0]*a[0][0] + m[2][1]*a[1][0] + m[2][2]*a[2][0] + m[2][3]*a[3][0];
+    result[3][0] = m[3][0]*a[0][0] + m[3][1]*a[1][0] + m[3][2]*a[2][0] + m[3][3]*a[3][0];
+    return result;
+}
+
+template <int R, int C> Mat<C,R> Mat<R,C>::transpose() const {
+    Mat<C,R> result;
+    for (int i=0; i<R; i++)
+        for (int j=0; j<C; j++)
+            result[j][i] = m[i][j];
+    return result;
+}
+
+template <int R, int C> Mat<R,C> Mat<R,C>::inverse() const {
+    static_assert(R==C, "inverse() needs a square matrix");
+    // augmenting the square matrix with the identity matrix of the same dimensions a => [ai]
+    float a[R][2*C];
+    for (int i=0; i<R; i++)
+        for (int j=0; j<C; j++) {
+            a[i][j]   = m[i][j];
+            a[i][j+C] = (i==j ? 1.f : 0.f);
+        }
+    // first pass
+    for (int i=0; i<R-1; i++) {
+        // normalize the first row
+        for (int j=2*C-1; j>=0; j--)
+            a[i][j] /= a[i][i];
+        for (int k=i+1; k<R; k++) {
+            float coeff = a[k][i];
+            for (int j=0; j<2*C; j++)
+                a[k][j] -= a[i][j]*coeff;
+        }
+    }
+    // normalize the last row
+    for (int j=2*C-1; j>=R-1; j--)
+        a[R-1][j] /= a[R-1][R-1];
+    // second pass
+    for (int i=R-1; i>0; i--) {
+        for (int k=i-1; k>=0; k--) {
+            float coeff = a[k][i];
+            for (int j=0; j<2*C; j++)
+                a[k][j] -= a[i][j]*coeff;
+        }
+    }
+    // cut the identity matrix back
+    Mat<R,C> result;
+    for (int i=0; i<R; i++)
+        for (int j=0; j<C; j++)
+            result.m[i][j] = a[i][j+C];
+    return result;
+}
+
+// Inverse 4x4 par les cofacteurs, sans pivot ni boucle
+template <> inline Mat4 Mat4::inverse() const {
+    const float (*a)[4] = m;
+    float s0 = a[0][0]*a[1][1] - a[1][0]*a[0][1];
+    float s1 = a[0][0]*a[1][2] - a[1][0]*a[0][2];
+    float s2 = a[0][0]*a[1][3] - a[1][0]*a[0][3];
+    float s3 = a[0][1]*a[1][2] - a[1][1]*a[0][2];
+    float s4 = a[0][1]*a[1][3] - a[1][1]*a[0][3];
+    float s5 = a[0][2]*a[1][3] - a[1][2]*a[0][3];
+    float c5 = a[2][2]*a[3][3] - a[3][2]*a[2][3];
+    float c4 = a[2][1]*a[3][3] - a[3][1]*a[2][3];
+    float c3 = a[2][1]*a[3][2] - a[3][1]*a[2][2];
+    float c2 = a[2][0]*a[3][3] - a[3][0]*a[2][3];
+    float c1 = a[2][0]*a[3][2] - a[3][0]*a[2][2];
+    float c0 = a[2][0]*a[3][1] - a[3][0]*a[2][1];
+    float invdet = 1.f/(s0*c5 - s1*c4 + s2*c3 + s3*c2 - s4*c1 + s5*c0);
+    Mat4 r;
+    r.m[0][0] = ( a[1][1]*c5 - a[1][2]*c4 + a[1][3]*c3)*invdet;
+    r.m[0][1] = (-a[0][1]*c5 + a[0][2]*c4 - a[0][3]*c3)*invdet;
+    r.m[0][2] = ( a[3][1]*s5 - a[3][2]*s4 + a[3][3]*s3)*invdet;
+    r.m[0][3] = (-a[2][1]*s5 + a[2][2]*s4 - a[2][3]*s3)*invdet;
+    r.m[1][0] = (-a[1][0]*c5 + a[1][2]*c2 - a[1][3]*c1)*invdet;
+    r.m[1][1] = ( a[0][0]*c5 - a[0][2]*c2 + a[0][3]*c1)*invdet;
+    r.m[1][2] = (-a[3][0]*s5 + a[3][2]*s2 - a[3][3]*s1)*invdet;
+    r.m[1][3] = ( a[2][0]*s5 - a[2][2]*s2 + a[2][3]*s1)*invdet;
+    r.m[2][0] = ( a[1][0]*c4 - a[1][1]*c2 + a[1][3]*c0)*invdet;
+    r.m[2][1] = (-a[0][0]*c4 + a[0][1]*c2 - a[0][3]*c0)*invdet;
+    r.m[2][2] = ( a[3][0]*s4 - a[3][1]*s2 + a[3][3]*s0)*invdet;
+    r.m[2][3] = (-a[2][0]*s4 + a[2][1]*s2 - a[2][3]*s0)*invdet;
+    r.m[3][0] = (-a[1][0]*c3 + a[1][1]*c1 - a[1][2]*c0)*invdet;
+    r.m[3][1] = ( a[0][0]*c3 - a[0][1]*c1 + a[0][2]*c0)*invdet;
+    r.m[3][2] = (-a[3][0]*s3 + a[3][1]*s1 - a[3][2]*s0)*invdet;
+    r.m[3][3] = ( a[2][0]*s3 - a[2][1]*s1 + a[2][2]*s0)*invdet;
+    return r;
+}
+
+template <int R, int C> std::ostream& operator<<(std::ostream& s, const Mat<R,C>& m) {
+    for (int i=0; i<R; i++)  {
+        for (int j=0; j<C; j++) {
+            s << m[i][j];
+            if (j<C-1) s << "\t";
+        }
+        s << "\n";
+    }
+    return s;
+}
+
 
 #endif //__GEOMETRY_H__
\ No newline at end of file
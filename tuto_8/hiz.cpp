@@ -0,0 +1,20 @@
+#include <algorithm>
+#include "hiz.h"
+
+HiZ::HiZ(float *zbuf, int w, int h) : zbuffer(zbuf), width(w), height(h),
+    blocks_x((w + HIZ_BLOCK - 1) / HIZ_BLOCK), blocks_y((h + HIZ_BLOCK - 1) / HIZ_BLOCK),
+    farthest_(blocks_x*blocks_y) {
+    for (int by = 0; by < blocks_y; by++)
+        for (int bx = 0; bx < blocks_x; bx++)
+            update(bx, by);
+}
+
+void HiZ::update(int bx, int by) {
+    int x0 = bx*HIZ_BLOCK, x1 = std::min(x0 + HIZ_BLOCK, width);
+    int y0 = by*HIZ_BLOCK, y1 = std::min(y0 + HIZ_BLOCK, height);
+    float z = zbuffer[x0+y0*width];
+    for (int y = y0; y < y1; y++)
+        for (int x = x0; x < x1; x++)
+            z = std::min(z, zbuffer[x+y*width]);
+    farthest_[bx+by*blocks_x] = z;
+}
@@ -0,0 +1,22 @@
+#ifndef __HIZ_H__
+#define __HIZ_H__
+
+#include <vector>
+
+// Z-buffer hiérarchique : pour chaque bloc HIZ_BLOCK x HIZ_BLOCK du zbuffer on garde
+// la profondeur la plus lointaine écrite (plus petit z, le z grandit vers la caméra).
+// Si un triangle est partout plus loin que cette valeur sur un bloc, le bloc entier peut être sauté.
+const int HIZ_BLOCK = 8;
+
+class HiZ {
+    float *zbuffer;
+    int width, height;
+    int blocks_x, blocks_y;
+    std::vector<float> farthest_;
+public:
+    HiZ(float *zbuffer, int width, int height);
+    float farthest(int bx, int by) const { return farthest_[bx+by*blocks_x]; }
+    void update(int bx, int by); // à appeler après avoir écrit dans le bloc
+};
+
+#endif //__HIZ_H__
@@ -2,12 +2,21 @@
 #include <cmath>
 #include <iostream>
 #include <unordered_map>
+#include <thread>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <chrono>
 #include "tgaimage.h"
 #include "model.h"
 #include "geometry.h"
+#include "transform.h"
+#include "culling.h"
+#include "tiles.h"
+#include "hiz.h"
+#include "rasterizer.h"
+#include "shaders.h"
 
-const TGAColor white = TGAColor(255, 255, 255, 255);
-const TGAColor red   = TGAColor(255, 0,   0,   255);
 Model *model = NULL;
 const int width  = 800;
 const int height = 800;
@@ -16,25 +25,33 @@ Vec3f eye(1,1,4);
 Vec3f center(0,0,0);
 Vec3f light_dir = Vec3f(1,1,0).normalize();
 
-// Image de profondeur
-TGAImage depthmap(width, height, TGAImage::GRAYSCALE);
-float *shadowbuffer = new float[width*height];
+// Carte d'ombre : résolution et biais de profondeur contre l'auto-ombrage
+const int   shadowmap_size = 1024;
+const float shadow_bias    = 4.f;
 
-Vec3f matrix2vector(Matrix m) {
-    return Vec3f(m[0][0]/m[3][0], m[1][0]/m[3][0], m[2][0]/m[3][0]);
-}
+// Taille du cache post-transformation FIFO simulé par Model::acmr (en sommets), pour les statistiques
+const int vertex_cache_size = 32;
 
-Matrix vector2matrix(Vec3f v) {
-    Matrix m(4, 1);
-    m[0][0] = v.x;
-    m[1][0] = v.y;
-    m[2][0] = v.z;
-    m[3][0] = 1.f;
-    return m;
-}
+// Taille maximale des meshlets, écartés en bloc hors du champ ou vus de dos, et ouverture
+// maximale de leur cône de normales (cosinus, environ 45°)
+const int   meshlet_vertices  = 64;
+const int   meshlet_triangles = 124;
+const float meshlet_cone_cos  = .7f;
+
+// Nombre de fragments ombrés, pour comparer rendu direct et rendu différé
+std::atomic<long> fragments_shaded(0);
+
+// G-buffer du rendu différé : face visible (-1 si aucune), coordonnées de texture interpolées
+// et niveau de mipmap (calculé par quad 2x2) par pixel
+struct GBuffer {
+    std::vector<int> face;
+    std::vector<Vec2f> uv;
+    std::vector<float> lod;
+    GBuffer(int w, int h) : face(w*h, -1), uv(w*h), lod(w*h) {}
+};
 
 Matrix viewport(int x, int y, int w, int h) {
-    Matrix m = Matrix::identity(4);
+    Matrix m = Matrix::identity();
     m[0][3] = x+w/2.f;
     m[1][3] = y+h/2.f;
     m[2][3] = depth/2.f;
@@ -49,7 +66,7 @@ Matrix lookat(Vec3f eye, Vec3f center, Vec3f up) {
     Vec3f z = (eye-center).normalize();
     Vec3f x = (up^z).normalize();
     Vec3f y = (z^x).normalize();
-    Matrix res = Matrix::identity(4);
+    Matrix res = Matrix::identity();
     for (int i=0; i<3; i++) {
         res[0][i] = x[i];
         res[1][i] = y[i];
@@ -59,18 +76,6 @@ Matrix lookat(Vec3f eye, Vec3f center, Vec3f up) {
     return res;
 }
 
-Vec3f calculBarycentrique(const Vec3f& A, const Vec3f& B, const Vec3f& C, const Vec3f& P) {
-    // Calcul de l'aire du triangle ABC
-    float aireABC = (float)((B.x - A.x) * (C.y - A.y) - (C.x - A.x) * (B.y - A.y));
-
-    // Calcul des coordonnées barycentriques
-    float alpha = ((B.y - C.y) * (P.x - C.x) + (C.x - B.x) * (P.y - C.y)) / aireABC;
-    float beta = ((C.y - A.y) * (P.x - C.x) + (A.x - C.x) * (P.y - C.y)) / aireABC;
-    float gamma = 1.0f - alpha - beta;
-
-    return Vec3f(alpha, beta, gamma);
-}
-
 Vec2f interpolationTexture(const Vec2f& t1, const Vec2f& t2, const Vec2f& t3, float alpha, float beta, float gamma) {
     float u = alpha * t1.x + beta * t2.x + gamma * t3.x;
     float v = alpha * t1.y + beta * t2.y + gamma * t3.y;
@@ -78,123 +83,280 @@ Vec2f interpolationTexture(const Vec2f& t1, const Vec2f& t2, const Vec2f& t3, fl
 }
 
 
-// On génère une depthmap pour les ombres en utilisant le buffer z
-void depthmap_triangle(Vec3f *pts, float *zbuffer) {
-    Vec2i boxMin, boxMax;
-    boxMin.y = std::min(pts[0].y, std::min(pts[1].y, pts[2].y));
-    boxMax.y = std::max(pts[0].y, std::max(pts[1].y, pts[2].y));
-    boxMin.x = std::min(pts[0].x, std::min(pts[1].x, pts[2].x));
-    boxMax.x = std::max(pts[0].x, std::max(pts[1].x, pts[2].x));
-
-    Vec3f P;
-    for (P.x = boxMin.x; P.x <= boxMax.x; P.x++) {
-        for (P.y = boxMin.y; P.y <= boxMax.y; P.y++) {
-            Vec3f bc_screen = calculBarycentrique(pts[0], pts[1], pts[2], P);
-            if (bc_screen.x < 0 || bc_screen.y < 0 || bc_screen.z < 0) continue;
-            P.z = 0;
-            for (int i = 0; i < 3; i++) P.z += pts[i].z * bc_screen[i];
-            if (zbuffer[int(P.x+P.y*width)] < P.z) {
-                zbuffer[int(P.x+P.y*width)] = P.z;
-                depthmap.set(P.x, P.y, TGAColor(255, 255, 255, 255));
-            }
+// Rendu différé, première passe : seuls la profondeur, l'indice de la face et les
+// coordonnées de texture interpolées sont écrits, l'ombrage est fait par resolve_gbuffer
+void gbuffer_triangle(Vec3f *pts, Vec2f *tex_coords, const Texture &texture, int face, float *zbuffer, GBuffer &gbuffer, HiZ &hiz,
+                      const TileRect &clip, CullMode cull, const ClippedFaces &clipped) {
+    float lod = 0;
+    rasterize_face(pts, face, &clipped, clip, hiz, cull, [&](Vec3f dx, Vec3f dy) {
+        lod = texture_lod(interpolationTexture(tex_coords[0], tex_coords[1], tex_coords[2], dx.x, dx.y, dx.z),
+                          interpolationTexture(tex_coords[0], tex_coords[1], tex_coords[2], dy.x, dy.y, dy.z),
+                          texture.width(), texture.height());
+    }, [&](int x, int y, float z, Vec3f coordBarycentrique) {
+        if (zbuffer[x+y*width] <= z) {
+            zbuffer[x+y*width] = z;
+            gbuffer.face[x+y*width] = face;
+            gbuffer.uv[x+y*width] = interpolationTexture(tex_coords[0], tex_coords[1], tex_coords[2], coordBarycentrique.x, coordBarycentrique.y, coordBarycentrique.z);
+            gbuffer.lod[x+y*width] = lod;
+            return true;
         }
-    }
+        return false;
+    });
 }
- 
-void triangle(Vec3f *pts, Vec2f *tex_coords, float *zbuffer, TGAImage &image, TGAImage &texture, TGAImage &normale, TGAImage &occlusion, Vec3f light_dir, float intensities[3]) { 
-    // On recupere la box du triangle
-    Vec2i boxMin, boxMax;
-    boxMin.y = std::min(pts[0].y, std::min(pts[1].y, pts[2].y));
-    boxMax.y = std::max(pts[0].y, std::max(pts[1].y, pts[2].y));
-    boxMin.x = std::min(pts[0].x, std::min(pts[1].x, pts[2].x));
-    boxMax.x = std::max(pts[0].x, std::max(pts[1].x, pts[2].x));
-
-    // On parcours la box du triangle
-    Vec3f P;
-    for (P.x = boxMin.x;P.x <= boxMax.x; P.x++) {
-        for (P.y = boxMin.y; P.y <= boxMax.y; P.y++) {
-            // On calcul les coordonnées barycentriques
-            Vec3f coordBarycentrique = calculBarycentrique(pts[0], pts[1], pts[2], P);
-
-            // On vérifie si le point P est à l'intérieur du triangle
-            if (coordBarycentrique.x > 0 && coordBarycentrique.y > 0 && coordBarycentrique.z > 0) {
-                P.z = 0.0;
-                // On récupère la profondeur du triangle
-                for (int i = 0; i < 3; i++) {
-                    if (i == 0) P.z += pts[i].z * coordBarycentrique.x;
-                    if (i == 1) P.z += pts[i].z * coordBarycentrique.y;
-                    if (i == 2) P.z += pts[i].z * coordBarycentrique.z;
-                }
-
-                // On regarde le buffer z est inferieur au z du triangle
-                if (zbuffer[int(P.x+P.y*width)] <= P.z) {
-                    zbuffer[int(P.x+P.y*width)] = P.z;
-
-                    // Interpolation des coordonnées de texture à l'intérieur du triangle
-                    Vec2f tex_coord = interpolationTexture(tex_coords[0], tex_coords[1], tex_coords[2], coordBarycentrique.x, coordBarycentrique.y, coordBarycentrique.z);
-
-                    // Calcul des coordonnées dans l'image de texture
-                    int tex_x = int(tex_coord.x * texture.get_width());
-                    int tex_y = int(tex_coord.y * texture.get_height());
-                    //std::cout << "Coordonnées texture " << tex_x << " " << tex_y << "\n";
 
-                    // Convertion de la couleur en un vecteur normal
-                    TGAColor color = normale.get(tex_x, texture.get_height() - tex_y);
-                    Vec3f normal(
-                        (color.r / 255.0f) * 2 - 1,
-                        (color.g / 255.0f) * 2 - 1,
-                        (color.b / 255.0f) * 2 - 1
-                    );
-
-                    // Calcul de l'occlusion ambiante
-                    color = occlusion.get(tex_x, texture.get_height() - tex_y);
-                    float ambient_occlusion = (color.r / 255.0f);
-
-                    // Calcul de l'intensité de la lumière
-                    float intensity = (normal * light_dir) + ambient_occlusion;
-
-                    // On vérifie que l'intensité de la lumière reste dans la plage [0, 1]
-                    intensity = std::max(0.0f, std::min(1.0f, intensity));
+// Rendu différé, deuxième passe : chaque pixel visible est ombré une seule fois
+template <class Shader, class Format> void resolve_gbuffer(Shader &shader, GBuffer &gbuffer, float *zbuffer, ImageView<Format> image) {
+    long shaded = 0;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            if (gbuffer.face[x+y*width] < 0) continue;
+            shader.lod = gbuffer.lod[x+y*width];
+            image.set(x, y, shader.shade(x, y, zbuffer[x+y*width], gbuffer.uv[x+y*width]));
+            shaded++;
+        }
+    }
+    fragments_shaded += shaded;
+}
 
-                    // On applique la texture à l'image avec l'intensité de la lumière
-                    color = texture.get(tex_x, texture.get_height() - tex_y);
 
-                    // On applique l'occlusion ambiante à l'image
-                    float shadow = 0.3 + 0.7*(shadowbuffer[int(P.x+P.y*width)] >= P.z);
-                    color.r *= intensity * shadow;
-                    color.g *= intensity * shadow;
-                    color.b *= intensity * shadow;
+// Mesure du coût d'une lecture de la carte d'ombre pour chaque noyau PCF. Les points parcourent
+// la carte ligne par ligne avec un léger bruit, comme les pixels d'un triangle pendant l'ombrage.
+void bench_pcf(const ShadowMap &shadow_map) {
+    const int size = shadow_map.size();
+    const int n = size*size;
+    std::vector<Vec3f> points(n);
+    unsigned int seed = 12345;
+    for (int i = 0; i < n; i++) {
+        seed = seed*1664525u + 1013904223u; float dx = (seed >> 8) / float(1 << 24);
+        seed = seed*1664525u + 1013904223u; float dy = (seed >> 8) / float(1 << 24);
+        seed = seed*1664525u + 1013904223u; float z  = (seed >> 8) / float(1 << 24);
+        points[i] = Vec3f(i%size + dx, i/size + dy, z*depth);
+    }
+    const char *names[4] = { "1x1", "2x2", "4x4", "poisson" };
+    double reference = 0;
+    for (int k = PCF_1x1; k <= PCF_POISSON; k++) {
+        float sum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < n; i++) sum += shadow_map.pcf(points[i], shadow_bias, PCFKernel(k));
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / n;
+        if (k == PCF_1x1) reference = ns;
+        std::cerr << "# pcf " << names[k] << " " << ns << " ns/lookup (x" << ns/reference << ") lit " << sum/n << std::endl;
+    }
+}
 
-                    // Affectation de la couleur au pixel dans l'image
-                    image.set(P.x, P.y, color);
+// Lectures de texture : ordre ligne par ligne de TGAImage contre tuiles 4x4 de Texture, pour des uv
+// tirés au hasard et pour des uv parcourant chaque face du modèle comme le ferait la rastérisation
+void bench_texture(TGAImage &image, const Texture &texture) {
+    const int w = texture.width(), h = texture.height();
+    std::vector<Vec2f> random_uv(1 << 22), walk_uv;
+    unsigned int seed = 12345;
+    for (size_t i = 0; i < random_uv.size(); i++) {
+        seed = seed*1664525u + 1013904223u; float u = (seed >> 8) / float(1 << 24);
+        seed = seed*1664525u + 1013904223u; float v = (seed >> 8) / float(1 << 24);
+        random_uv[i] = Vec2f(u, v);
+    }
+    const int steps = 16;
+    for (int f = 0; f < model->nfaces(); f++) {
+        FaceIndices fv = model->face_vertices(f);
+        Vec2f a = model->vertex(fv[0]).uv, b = model->vertex(fv[1]).uv, c = model->vertex(fv[2]).uv;
+        for (int i = 0; i <= steps; i++)
+            for (int j = 0; i + j <= steps; j++)
+                walk_uv.push_back(a*(float(i)/steps) + b*(float(j)/steps) + c*(float(steps-i-j)/steps));
+    }
+    const char *patterns[2] = { "random", "walk" };
+    const std::vector<Vec2f> *uvs[2] = { &random_uv, &walk_uv };
+    for (int p = 0; p < 2; p++) {
+        const std::vector<Vec2f> &uv = *uvs[p];
+        const size_t n = uv.size();
+        double ns[4];
+        unsigned int sum[4] = { 0, 0, 0, 0 };
+        for (int k = 0; k < 4; k++) {
+            auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < n; i++) {
+                int x = std::min(int(uv[i].x*w), w-1), y = std::min(int((1.f-uv[i].y)*h), h-1);
+                switch (k) {
+                    case 0:  sum[k] += image.get(x, y).val; break;
+                    case 1:  sum[k] += texture.get(x, y).val; break;
+                    case 2:  sum[k] += image.sample(uv[i].x, uv[i].y, 0).val; break;
+                    default: sum[k] += texture.sample(uv[i].x, uv[i].y, 0).pack().val; break;
                 }
             }
+            ns[k] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / n;
+        }
+        std::cerr << "# texture " << patterns[p] << " (" << n << " lectures) : get " << ns[0] << " ns -> tuiles " << ns[1]
+                  << " ns, bilinéaire " << ns[2] << " ns -> tuiles " << ns[3] << " ns"
+                  << (sum[0] == sum[1] && sum[2] == sum[3] ? "" : " RESULTATS DIFFERENTS") << std::endl;
+    }
+}
+
+// Test de la règle de remplissage : les faces vues de face sont rastérisées sans test de profondeur,
+// en notant les faces qui touchent chaque pixel. Deux faces voisines (qui partagent une arête) ne se
+// recouvrent pas à l'écran, un pixel touché par les deux est donc dessiné deux fois sur l'arête commune.
+// Le test est refait avec les sommets arrondis au pixel : beaucoup de centres de pixels tombent alors
+// exactement sur une arête, seule la règle haut-gauche évite qu'ils soient dessinés deux fois.
+void bench_overdraw(const Matrix &MVP) {
+    std::vector<Vec3f> screen_verts;
+    transform_vertices(MVP, model, screen_verts);
+    auto neighbours = [](int f, int g) {
+        int shared = 0;
+        for (int a : model->face(f))
+            for (int b : model->face(g)) shared += a == b;
+        return shared >= 2;
+    };
+    for (int snap = 0; snap <= 1; snap++) {
+        std::vector<float> zbuffer(width*height, std::numeric_limits<int>::min());
+        HiZ hiz(zbuffer.data(), width, height);
+        std::vector<std::vector<int>> hits(width*height);
+        long fragments = 0;
+        for (int f = 0; f < model->nfaces(); f++) {
+            Vec3f pts[3];
+            for (int j = 0; j < 3; j++) {
+                pts[j] = screen_verts[model->face(f)[j]];
+                if (snap) pts[j] = Vec3f(std::round(pts[j].x), std::round(pts[j].y), pts[j].z);
+            }
+            rasterize(pts, TileRect(0, 0, width-1, height-1), hiz, [&](int x, int y, Vec3f) {
+                hits[x+y*width].push_back(f);
+                fragments++;
+                return false;
+            }, CULL_BACK);
+        }
+        long covered = 0, overdrawn = 0, edge_hits = 0;
+        for (const std::vector<int> &faces : hits) {
+            if (faces.empty()) continue;
+            covered++;
+            if (faces.size() < 2) continue;
+            overdrawn++;
+            bool twice = false;
+            for (size_t i = 0; i < faces.size() && !twice; i++)
+                for (size_t j = i+1; j < faces.size() && !twice; j++) twice = neighbours(faces[i], faces[j]);
+            edge_hits += twice;
         }
+        std::cerr << "# overdraw" << (snap ? " (sommets arrondis au pixel) " : " ") << fragments << " fragments, " << covered
+                  << " pixels couverts, " << overdrawn << " touchés plusieurs fois, " << edge_hits
+                  << " deux fois par des faces voisines" << std::endl;
     }
-} 
+}
 
+// Mesure du temps de chargement d'un fichier OBJ, lu depuis le texte puis depuis le cache binaire
+void bench_load(const char *filename, int nthreads) {
+    const int n = 20;
+    for (int use_cache = 0; use_cache <= 1; use_cache++) {
+        int nfaces = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < n; i++) {
+            Model m(filename, nthreads, use_cache);
+            nfaces += m.nfaces();
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / n;
+        std::cerr << "# load " << filename << (use_cache ? " cache " : " obj ") << nthreads << " threads "
+                  << ms << " ms (" << nfaces/n << " faces)" << std::endl;
+    }
+    Model m(filename, nthreads);
+    auto start = std::chrono::steady_clock::now();
+    m.build_vertex_buffer();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "# vertex buffer " << ms << " ms" << std::endl;
+}
+
+// Outil hors rendu : ACMR (sommets transformés par triangle) d'un cache post-transformation FIFO de
+// vertex_cache_size sommets, pour l'ordre des faces du fichier et après l'algorithme de Forsyth,
+// puis une fois les faces regroupées en meshlets à partir de chacun de ces ordres
+void bench_vcache(const char *filename, int nthreads) {
+    for (int forsyth = 0; forsyth <= 1; forsyth++) {
+        Model m(filename, nthreads);
+        m.build_vertex_buffer();
+        float acmr = m.acmr(vertex_cache_size);
+        auto start = std::chrono::steady_clock::now();
+        if (forsyth) m.optimize_face_order(vertex_cache_size);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        float acmr_order = m.acmr(vertex_cache_size);
+        m.build_meshlets(meshlet_vertices, meshlet_triangles, meshlet_cone_cos);
+        std::cerr << "# acmr " << acmr;
+        if (forsyth) std::cerr << " -> " << acmr_order << " (forsyth, " << ms << " ms)";
+        std::cerr << " -> " << m.acmr(vertex_cache_size) << " (meshlets, cache " << vertex_cache_size << ")" << std::endl;
+    }
+}
 
 int main(int argc, char** argv) {
-    if (2==argc) {
-        model = new Model(argv[1]);
+    // Nombre de threads du chargement et du rendu par tuiles (1 = mono-thread)
+    int nthreads = std::max(1u, std::thread::hardware_concurrency());
+    if (3<=argc) {
+        nthreads = std::max(1, atoi(argv[2]));
+    }
+
+    if (2<=argc) {
+        model = new Model(argv[1], nthreads);
     } else {
-        model = new Model("obj/diablo3_pose.obj");
+        model = new Model("obj/diablo3_pose.obj", nthreads);
+    }
+    // Un seul indice par coin de face pour la position, l'uv et la normale, puis faces regroupées en meshlets.
+    // Ces passes dépendent des limites des meshlets : elles sont refaites à chaque lancement, pas rangées
+    // dans le cache .mesh. L'étage de sommets transforme chaque position une seule fois, l'ordre des faces
+    // pour un cache post-transformation (optimize_face_order) n'est donc mesuré que par vcachebench.
+    model->build_vertex_buffer();
+    model->build_meshlets(meshlet_vertices, meshlet_triangles, meshlet_cone_cos);
+    std::cerr << "# acmr " << model->acmr(vertex_cache_size) << " (meshlets, cache " << vertex_cache_size << ")" << std::endl;
+
+    // Shader utilisé : flat, gouraud, normalmap, ao, shadow (par défaut) ou deferred
+    // (rendu différé du shader shadow : passe de profondeur + G-buffer puis ombrage des seuls pixels visibles),
+    // pcfbench mesure le coût des noyaux PCF sans faire le rendu, loadbench le temps de chargement du modèle,
+    // texbench le débit des lectures de texture selon le rangement des texels, overdraw vérifie la règle de
+    // remplissage (pixels dessinés deux fois sur les arêtes partagées, à lancer sur obj/african_head.obj),
+    // vcachebench l'efficacité d'un cache post-transformation selon l'ordre des faces
+    const char *mode = 4<=argc ? argv[3] : "shadow";
+    if (!strcmp(mode, "loadbench")) {
+        bench_load(2<=argc ? argv[1] : "obj/diablo3_pose.obj", nthreads);
+        delete model;
+        return 0;
+    }
+    if (!strcmp(mode, "vcachebench")) {
+        bench_vcache(2<=argc ? argv[1] : "obj/diablo3_pose.obj", nthreads);
+        delete model;
+        return 0;
+    }
+    bool deferred = !strcmp(mode, "deferred");
+
+    // Noyau PCF des ombres : 1x1, 2x2, 4x4 (par défaut) ou poisson
+    PCFKernel kernel = PCF_4x4;
+    if (5<=argc) {
+        if (!strcmp(argv[4], "1x1")) kernel = PCF_1x1;
+        if (!strcmp(argv[4], "2x2")) kernel = PCF_2x2;
+        if (!strcmp(argv[4], "poisson")) kernel = PCF_POISSON;
+    }
+
+    // Faces écartées selon leur orientation à l'écran : none, back (par défaut) ou front
+    CullMode cull = CULL_BACK;
+    if (6<=argc) {
+        if (!strcmp(argv[5], "none")) cull = CULL_NONE;
+        if (!strcmp(argv[5], "front")) cull = CULL_FRONT;
     }
 
     // Image resultante
     TGAImage image(width, height, TGAImage::RGB);
+    ImageView<RGB8> image_view(image); // accès sans vérification pour les boucles de rendu
 
     // Texture
-    TGAImage texture; 
-    texture.read_tga_file("texture/diablo3_pose_diffuse.tga");
+    TGAImage texture_image;
+    texture_image.read_tga_file("texture/diablo3_pose_diffuse.tga");
 
     // Normale
-    TGAImage normale;
-    normale.read_tga_file("texture/diablo3_pose_nm.tga");
+    TGAImage normale_image;
+    normale_image.read_tga_file("texture/diablo3_pose_nm.tga");
 
     // Occlusion ambiante
-    TGAImage occlusion;
-    occlusion.read_tga_file("texture/diablo3_pose_ao.tga");
+    TGAImage occlusion_image;
+    occlusion_image.read_tga_file("texture/diablo3_pose_ao.tga");
+
+    // Chaînes de mipmaps pour l'échantillonnage trilinéaire, puis copie des texels par tuiles de 4x4
+    texture_image.generate_mipmaps();
+    normale_image.generate_mipmaps();
+    occlusion_image.generate_mipmaps();
+    Texture texture(texture_image), normale(normale_image), occlusion(occlusion_image);
+    if (!strcmp(mode, "texbench")) {
+        bench_texture(texture_image, texture);
+        delete model;
+        return 0;
+    }
 
     float *zbuffer = new float[width*height];
 
@@ -202,52 +364,119 @@ int main(int argc, char** argv) {
         zbuffer[i] = std::numeric_limits<int>::min();
     }
 
-    // Après avoir initialisé le zbuffer
-    for (int i = 0; i < width * height; i++) {
-        shadowbuffer[i] = std::numeric_limits<int>::min();
-    }
+    // Z-buffer hiérarchique (les tuiles font un multiple de HIZ_BLOCK, chaque bloc n'a qu'un seul thread)
+    HiZ zbuffer_hiz(zbuffer, width, height);
 
-    std::vector<std::vector<Vec2f>> all_tex_coords;
-    std::vector<std::vector<Vec2f>> all_norm_coords;
+    GBuffer gbuffer(deferred ? width : 0, deferred ? height : 0);
 
 
     // Trucs pour la caméra
     Matrix ModelView  = lookat(eye, center, Vec3f(0,1,0));
-    Matrix Projection = Matrix::identity(4);
+    Matrix Projection = Matrix::identity();
     Matrix ViewPort   = viewport(width/8, height/8, width*3/4, height*3/4);
     Projection[3][2] = -1.f/(eye-center).norm();
-    Matrix z = (ViewPort*Projection*ModelView);
-    
-    // On parcours les faces du modèle
-	for (int i = 0; i < model->nfaces(); i++) {
-        std::vector<int> face = model->face(i);
-        Vec3f screen_coords[3];
-        Vec3f world_coords[3];
-        Vec2f tex_coords[3];
-        Vec3f norm_vectors[3];
-        float intensities[3];
-
-        // On parcours les sommets du triangle
-        for (int j = 0; j < 3; j++) {
-            Vec3f v = model->vert(face[j]);
-            screen_coords[j] =  Vec3f(ViewPort*Projection*ModelView*Matrix(v));
-            world_coords[j] = v;
-            //std::cout << screen_coords[j].x << " " << screen_coords[j].y << " " << screen_coords[j] << "\n";
-
-            // Coordoonnées de la texture vt dans le modele
-            int vt_index = model->texture_index(i, j); // Indice de la coordonnée de texture pour ce sommet (f v1/vt1/vn1 v2/vt2/vn2 v3/vt3/vn3)
-            tex_coords[j] = model->texture(vt_index);
-
-            // On calcul l'intensité de la lumière pour chaque sommet
-            intensities[j] = v * light_dir;
+    Matrix MVP = ViewPort*Projection*ModelView;
+    if (!strcmp(mode, "overdraw")) {
+        bench_overdraw(MVP);
+        delete model;
+        return 0;
+    }
+
+    // Meshlets hors du champ de la caméra, ou dont toutes les faces seraient écartées par le mode cull
+    // (entièrement vus de dos, ou de face avec front) : leurs faces sautent l'étage de sommets
+    Frustum frustum(MVP, width, height);
+    std::vector<bool> face_visible(model->nfaces(), true);
+    int meshlets_culled = 0, faces_culled = 0;
+    for (int i = 0; i < model->nmeshlets(); i++) {
+        const Meshlet &m = model->meshlet(i);
+        bool culled = (cull == CULL_BACK && cone_backfacing(m, eye)) || (cull == CULL_FRONT && cone_frontfacing(m, eye));
+        if (frustum.sphere_visible(m.center, m.radius) && !culled) continue;
+        std::fill(face_visible.begin() + m.first_face, face_visible.begin() + m.first_face + m.nfaces, false);
+        meshlets_culled++;
+        faces_culled += m.nfaces;
+    }
+    std::cerr << "# meshlets culled " << meshlets_culled << " of " << model->nmeshlets() << " (" << faces_culled << " of " << model->nfaces() << " faces)" << std::endl;
+
+    // Coordonnées homogènes de chaque coin des faces visibles, chaque position utilisée n'est transformée qu'une fois
+    std::vector<ClipVertex> clip_verts;
+    long transformed = transform_corners(MVP, model, face_visible, clip_verts);
+    std::cerr << "# vertices transformed " << transformed << " of " << model->nverts() << " ("
+              << transform_vertices_path() << ")" << std::endl;
+
+    // Découpage des seules faces qui traversent le plan proche ou la bande de garde,
+    // les autres sont divisées par w pour donner les coordonnées écran de leurs coins
+    std::vector<Vec3f> screen_verts;
+    ClippedFaces clipped;
+    clipped.clip(model, clip_verts, face_visible, width, height, screen_verts);
+    std::cerr << "# faces clipped " << clipped.nclipped() << std::endl;
+
+    // Carte d'ombre : la lumière est directionnelle, projection orthographique dans la direction light_dir.
+    // Elle n'est rendue qu'une fois tant que la lumière et le modèle ne changent pas.
+    ShadowMap shadow_map(shadowmap_size);
+    Matrix LightView = viewport(shadowmap_size/8, shadowmap_size/8, shadowmap_size*3/4, shadowmap_size*3/4)*lookat(light_dir, center, Vec3f(0,1,0));
+    shadow_map.update(model, LightView, nthreads);
+    if (!strcmp(mode, "pcfbench")) {
+        bench_pcf(shadow_map);
+        delete model;
+        return 0;
+    }
+
+    // Boîte englobante de chaque face pour le binning par tuiles
+    std::vector<TileRect> face_boxes(model->nfaces());
+    for (int i = 0; i < model->nfaces(); i++) {
+        if (!face_visible[i]) continue;
+        if (!clipped.is_clipped(i)) {
+            face_boxes[i] = bounding_box(&screen_verts[model->face_offset(i)]);
+            continue;
+        }
+        for (const ClipTriangle *t = clipped.begin(i); t != clipped.end(i); t++) {
+            TileRect box = bounding_box(t->pts);
+            if (face_boxes[i].empty()) face_boxes[i] = box;
+            face_boxes[i] = TileRect(std::min(face_boxes[i].x0, box.x0), std::min(face_boxes[i].y0, box.y0),
+                                     std::max(face_boxes[i].x1, box.x1), std::max(face_boxes[i].y1, box.y1));
         }
+    }
 
-        // On fait la depthmap
-        depthmap_triangle(screen_coords, shadowbuffer);
+    // Forward : on dessine chaque face avec le shader, en se limitant au rectangle clip de la tuile
+    auto draw_with = [&](auto &shader) {
+        render_tiles(width, height, nthreads, face_boxes, [&](int i, const TileRect &clip) {
+            fragments_shaded += triangle(shader, i, zbuffer, image_view, zbuffer_hiz, clip, cull, &clipped);
+        });
+    };
+
+    ShadowShader shadow_shader(model, screen_verts, texture, normale, occlusion, light_dir, shadow_map, MVP, shadow_bias, kernel);
+    if (deferred) {
+        render_tiles(width, height, nthreads, face_boxes, [&](int i, const TileRect &clip) {
+            Vec3f screen_coords[3];
+            Vec2f tex_coords[3];
+            for (int j = 0; j < 3; j++) {
+                screen_coords[j] = screen_verts[model->face_offset(i) + j];
+                tex_coords[j] = model->vertex(model->face_vertices(i)[j]).uv;
+            }
+            gbuffer_triangle(screen_coords, tex_coords, texture, i, zbuffer, gbuffer, zbuffer_hiz, clip, cull, clipped);
+        });
+        resolve_gbuffer(shadow_shader, gbuffer, zbuffer, image_view);
+    } else if (!strcmp(mode, "flat")) {
+        FlatShader shader(model, screen_verts, texture, light_dir);
+        draw_with(shader);
+    } else if (!strcmp(mode, "gouraud")) {
+        GouraudShader shader(model, screen_verts, texture, light_dir);
+        draw_with(shader);
+    } else if (!strcmp(mode, "normalmap")) {
+        NormalMapShader shader(model, screen_verts, texture, normale, light_dir);
+        draw_with(shader);
+    } else if (!strcmp(mode, "ao")) {
+        AOShader shader(model, screen_verts, texture, normale, occlusion, light_dir);
+        draw_with(shader);
+    } else {
+        draw_with(shadow_shader);
+    }
 
-        // On dessine le triangle
-        triangle(screen_coords, tex_coords, zbuffer, image, texture, normale, occlusion, light_dir, intensities);
+    long visible = 0;
+    for (int i = 0; i < width * height; i++) {
+        if (zbuffer[i] != std::numeric_limits<int>::min()) visible++;
     }
+    std::cerr << "# fragments shaded " << fragments_shaded << " visible pixels " << visible << std::endl;
 
     image.flip_vertically(); // i want to have the origin at the left bottom corner of the image
     image.write_tga_file("output.tga");
@@ -0,0 +1,156 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "meshcache.h"
+
+static_assert(sizeof(Vec3f) == 3*sizeof(float) && sizeof(Vec2f) == 2*sizeof(float), "Vec2f/Vec3f doivent être compacts");
+
+const char MESH_MAGIC[8] = { 'T', 'U', 'T', 'O', 'M', 'E', 'S', 'H' };
+const uint32_t MESH_VERSION = 2;
+const uint32_t MESH_ENDIAN = 0x01020304;  // relu 0x04030201 sur une machine d'un autre boutisme
+const size_t MESH_ALIGN = 64;
+
+enum { SECTION_VERTS, SECTION_VERTS_X, SECTION_VERTS_Y, SECTION_VERTS_Z, SECTION_TEXTURE, SECTION_NORMAL,
+       SECTION_FACE_OFFSETS, SECTION_VERT_INDEX, SECTION_TEXTURE_INDEX, SECTION_NORMAL_INDEX, NSECTIONS };
+
+// En-tête du fichier, les sections commencent à des positions multiples de MESH_ALIGN
+struct MeshHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t endian;
+    uint64_t source_size;   // taille et date de modification du fichier OBJ d'origine
+    int64_t source_mtime_sec;
+    int64_t source_mtime_nsec;
+    uint64_t nverts, ntexture, nnormal, nfaces, nindices;
+    uint64_t offset[NSECTIONS];
+    uint64_t size[NSECTIONS];
+};
+
+static size_t align(size_t n) {
+    return (n + MESH_ALIGN - 1) / MESH_ALIGN * MESH_ALIGN;
+}
+
+// Remplit la taille et la position de chaque section, renvoie la taille totale du fichier
+static size_t layout(MeshHeader &h) {
+    h.size[SECTION_VERTS] = h.nverts * sizeof(Vec3f);
+    h.size[SECTION_VERTS_X] = h.size[SECTION_VERTS_Y] = h.size[SECTION_VERTS_Z] = h.nverts * sizeof(float);
+    h.size[SECTION_TEXTURE] = h.ntexture * sizeof(Vec2f);
+    h.size[SECTION_NORMAL] = h.nnormal * sizeof(Vec3f);
+    h.size[SECTION_FACE_OFFSETS] = (h.nfaces + 1) * sizeof(uint32_t);
+    h.size[SECTION_VERT_INDEX] = h.nindices * sizeof(uint32_t);
+    h.size[SECTION_TEXTURE_INDEX] = h.nindices * sizeof(uint32_t);
+    h.size[SECTION_NORMAL_INDEX] = h.nindices * sizeof(uint32_t);
+    size_t pos = align(sizeof(MeshHeader));
+    for (int s = 0; s < NSECTIONS; s++) {
+        h.offset[s] = pos;
+        pos = align(pos + h.size[s]);
+    }
+    return pos;
+}
+
+bool MeshCache::open(const char *path, const char *source) {
+    close();
+    struct stat src, st;
+    if (stat(source, &src) < 0) return false;
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) return false;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(MeshHeader)) {
+        ::close(fd);
+        return false;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) return false;
+
+    const MeshHeader *h = (const MeshHeader *)map;
+    MeshHeader expected = *h;
+    bool valid = !memcmp(h->magic, MESH_MAGIC, sizeof(MESH_MAGIC)) && h->version == MESH_VERSION && h->endian == MESH_ENDIAN
+        && h->source_size == (uint64_t)src.st_size && h->source_mtime_sec == (int64_t)src.st_mtim.tv_sec
+        && h->source_mtime_nsec == (int64_t)src.st_mtim.tv_nsec
+        && layout(expected) == (size_t)st.st_size && !memcmp(expected.offset, h->offset, sizeof(h->offset));
+    if (!valid) {
+        munmap(map, st.st_size);
+        return false;
+    }
+    map_ = map;
+    size_ = st.st_size;
+    const char *base = (const char *)map;
+    arrays_.verts = (const Vec3f *)(base + h->offset[SECTION_VERTS]);
+    arrays_.verts_x = (const float *)(base + h->offset[SECTION_VERTS_X]);
+    arrays_.verts_y = (const float *)(base + h->offset[SECTION_VERTS_Y]);
+    arrays_.verts_z = (const float *)(base + h->offset[SECTION_VERTS_Z]);
+    arrays_.texture = (const Vec2f *)(base + h->offset[SECTION_TEXTURE]);
+    arrays_.normal = (const Vec3f *)(base + h->offset[SECTION_NORMAL]);
+    arrays_.face_offsets = (const uint32_t *)(base + h->offset[SECTION_FACE_OFFSETS]);
+    arrays_.vert_index = (const uint32_t *)(base + h->offset[SECTION_VERT_INDEX]);
+    arrays_.texture_index = (const uint32_t *)(base + h->offset[SECTION_TEXTURE_INDEX]);
+    arrays_.normal_index = (const uint32_t *)(base + h->offset[SECTION_NORMAL_INDEX]);
+    arrays_.nverts = h->nverts;
+    arrays_.ntexture = h->ntexture;
+    arrays_.nnormal = h->nnormal;
+    arrays_.nfaces = h->nfaces;
+    if (arrays_.face_offsets[arrays_.nfaces] != h->nindices) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MeshCache::close() {
+    if (map_) munmap(map_, size_);
+    map_ = NULL;
+    size_ = 0;
+    arrays_ = MeshArrays();
+}
+
+bool write_mesh_cache(const char *path, const char *source, const MeshArrays &arrays) {
+    struct stat src;
+    if (stat(source, &src) < 0) return false;
+    MeshHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, MESH_MAGIC, sizeof(MESH_MAGIC));
+    h.version = MESH_VERSION;
+    h.endian = MESH_ENDIAN;
+    h.source_size = src.st_size;
+    h.source_mtime_sec = src.st_mtim.tv_sec;
+    h.source_mtime_nsec = src.st_mtim.tv_nsec;
+    h.nverts = arrays.nverts;
+    h.ntexture = arrays.ntexture;
+    h.nnormal = arrays.nnormal;
+    h.nfaces = arrays.nfaces;
+    h.nindices = arrays.nindices();
+    size_t total = layout(h);
+
+    const void *data[NSECTIONS] = { arrays.verts, arrays.verts_x, arrays.verts_y, arrays.verts_z, arrays.texture,
+                                    arrays.normal, arrays.face_offsets, arrays.vert_index, arrays.texture_index, arrays.normal_index };
+    // Ecriture dans un fichier temporaire renommé à la fin : un autre processus ne voit jamais un cache à moitié écrit.
+    // Le nom est unique (mkstemp), deux processus qui écrivent le même cache ne se marchent pas dessus.
+    std::string tmp = std::string(path) + ".XXXXXX";
+    int fd = mkstemp(&tmp[0]);
+    if (fd < 0) return false;
+    fchmod(fd, 0644); // mkstemp crée le fichier en 0600
+    FILE *f = fdopen(fd, "wb");
+    if (!f) {
+        ::close(fd);
+        unlink(tmp.c_str());
+        return false;
+    }
+    static const char zeros[MESH_ALIGN] = {};
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+    size_t pos = sizeof(h);
+    for (int s = 0; s < NSECTIONS && ok; s++) {
+        ok = fwrite(zeros, 1, h.offset[s] - pos, f) == h.offset[s] - pos;
+        if (ok && h.size[s]) ok = fwrite(data[s], 1, h.size[s], f) == h.size[s];
+        pos = h.offset[s] + h.size[s];
+    }
+    if (ok) ok = fwrite(zeros, 1, total - pos, f) == total - pos;
+    ok = (fclose(f) == 0) && ok;
+    if (ok) ok = rename(tmp.c_str(), path) == 0;
+    if (!ok) unlink(tmp.c_str());
+    return ok;
+}
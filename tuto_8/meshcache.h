@@ -0,0 +1,51 @@
+#ifndef __MESHCACHE_H__
+#define __MESHCACHE_H__
+
+#include <cstddef>
+#include <cstdint>
+#include "geometry.h"
+
+// Cache binaire d'un maillage lu dans un fichier OBJ. Le fichier contient un en-tête versionné
+// suivi des tableaux du modèle, chacun aligné sur 64 octets, tels qu'ils sont en mémoire :
+// il suffit de le projeter (mmap) pour s'en servir, sans lecture ni copie.
+// Le cache est invalide si la taille ou la date de modification du fichier source a changé.
+
+// Tableaux d'un maillage. Les indices de la face i (à partir de 0) sont
+// vert_index[face_offsets[i] .. face_offsets[i+1]-1], de même pour texture_index et normal_index.
+struct MeshArrays {
+    const Vec3f *verts;
+    const float *verts_x, *verts_y, *verts_z; // positions en structure de tableaux
+    const Vec2f *texture;
+    const Vec3f *normal;
+    const uint32_t *face_offsets; // nfaces+1 valeurs
+    const uint32_t *vert_index;
+    const uint32_t *texture_index;
+    const uint32_t *normal_index;
+    size_t nverts, ntexture, nnormal, nfaces;
+    MeshArrays() : verts(NULL), verts_x(NULL), verts_y(NULL), verts_z(NULL), texture(NULL), normal(NULL),
+                   face_offsets(NULL), vert_index(NULL), texture_index(NULL), normal_index(NULL),
+                   nverts(0), ntexture(0), nnormal(0), nfaces(0) {}
+    size_t nindices() const { return nfaces ? face_offsets[nfaces] : 0; }
+};
+
+// Fichier de cache projeté en lecture seule
+class MeshCache {
+    void *map_;
+    size_t size_;
+    MeshArrays arrays_;
+public:
+    MeshCache() : map_(NULL), size_(0) {}
+    ~MeshCache() { close(); }
+    MeshCache(const MeshCache &) = delete;
+    MeshCache &operator=(const MeshCache &) = delete;
+    // Projette le cache path de source, false s'il n'existe pas ou n'est plus à jour
+    bool open(const char *path, const char *source);
+    void close();
+    bool is_open() const { return map_ != NULL; }
+    const MeshArrays &arrays() const { return arrays_; }
+};
+
+// Ecrit le cache path de source, false en cas d'échec (répertoire en lecture seule...)
+bool write_mesh_cache(const char *path, const char *source, const MeshArrays &arrays);
+
+#endif //__MESHCACHE_H__
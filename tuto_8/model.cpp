@@ -1,89 +1,541 @@
 #include <iostream>
-#include <string>
-#include <fstream>
-#include <sstream>
 #include <vector>
+#include <string>
+#include <algorithm>
+#include <thread>
+#include <functional>
+#include <unordered_map>
+#include <cmath>
+#include <charconv>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "model.h"
 
-Model::Model(const char *filename) : verts_(), faces_(), texture_(), texture_index_(), normal_(), normal_index_() {
-    std::ifstream in;
-    in.open (filename, std::ifstream::in);
-    if (in.fail()) return;
-    std::string line;
-    while (!in.eof()) {
-        std::getline(in, line);
-        std::istringstream iss(line.c_str());
-        char trash;
-        if (!line.compare(0, 2, "v ")) {
-            iss >> trash;
+// Lecture du fichier OBJ : le fichier est projeté en mémoire (mmap) et découpé à la main,
+// les nombres sont lus avec std::from_chars, sans copie de ligne ni istringstream.
+// Les nombres sont lus comme le ferait operator>> (espaces ignorés, '+' accepté).
+static const char *skip_spaces(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    return p;
+}
+
+template <class T> static bool parse_number(const char *&p, const char *end, T &value) {
+    p = skip_spaces(p, end);
+    if (p < end && *p == '+') p++;
+    std::from_chars_result r = std::from_chars(p, end, value);
+    if (r.ec != std::errc()) return false;
+    p = r.ptr;
+    return true;
+}
+
+// Equivalent de "iss >> trash" : un caractère quelconque après les espaces
+static bool skip_char(const char *&p, const char *end) {
+    p = skip_spaces(p, end);
+    if (p >= end) return false;
+    p++;
+    return true;
+}
+
+// Résultat de la lecture d'un morceau du fichier, indices rangés à plat comme dans le modèle.
+// Les indices négatifs de l'OBJ (relatifs au dernier sommet lu) ne peuvent être résolus qu'une fois
+// connu le nombre de sommets des morceaux précédents : on garde leur position dans fixups pour y
+// ajouter ce décalage ensuite.
+struct ObjChunk {
+    std::vector<Vec3f> verts;
+    std::vector<Vec2f> texture;
+    std::vector<Vec3f> normal;
+    std::vector<uint32_t> face_offsets; // début de chaque face dans les tableaux d'indices du morceau
+    std::vector<uint32_t> vert_index, texture_index, normal_index;
+    std::vector<uint32_t> fixups[3]; // positions des indices v, vt et vn relatifs
+};
+
+// Indice de l'OBJ (à partir de 1, ou négatif s'il est relatif) vers un indice à partir de 0
+// dans le morceau ; un indice relatif est noté dans fixups pour être décalé plus tard
+static uint32_t resolve_index(int idx, size_t count, std::vector<uint32_t> &fixups, size_t pos) {
+    if (idx > 0) return idx - 1;
+    fixups.push_back(pos);
+    return uint32_t(count + idx);
+}
+
+// Lecture des lignes v, vt, vn et f entre begin et end (qui tombent sur des débuts de ligne)
+static void parse_chunk(const char *begin, const char *file_end, ObjChunk &chunk) {
+    for (const char *line = begin; line < file_end; ) {
+        const char *end = (const char *)memchr(line, '\n', file_end - line);
+        if (!end) end = file_end;
+        size_t len = end - line;
+        const char *p = line;
+        if (len >= 2 && line[0] == 'v' && line[1] == ' ') {
+            p += 2;
             Vec3f v;
-            for (int i=0;i<3;i++) iss >> v[i];
-            verts_.push_back(v);
-        } else if (!line.compare(0, 3, "vt ")) { // Coordonnées textures
-            iss >> trash >> trash;
+            for (int i=0;i<3;i++) parse_number(p, end, v[i]);
+            chunk.verts.push_back(v);
+        } else if (len >= 3 && line[0] == 'v' && line[1] == 't' && line[2] == ' ') { // Coordonnées textures
+            p += 3;
             Vec2f vt;
-            for (int i = 0; i < 2; i++) iss >> vt[i];
-            texture_.push_back(vt);
-        }else if (!line.compare(0, 3, "vn ")) { // Coordonnées normales
-            iss >> trash >> trash;
+            for (int i = 0; i < 2; i++) parse_number(p, end, vt[i]);
+            chunk.texture.push_back(vt);
+        } else if (len >= 3 && line[0] == 'v' && line[1] == 'n' && line[2] == ' ') { // Coordonnées normales
+            p += 3;
             Vec3f vn;
-            for (int i = 0; i < 3; i++) iss >> vn[i];
-            normal_.push_back(vn);
-        } else if (!line.compare(0, 2, "f ")) {
-            std::vector<int> f;
-            std::vector<int> vt_indices; // Indices des coordonnées de texture (vt)
-            std::vector<int> vn_indices; // Indices des coordonnées de texture (vn)
+            for (int i = 0; i < 3; i++) parse_number(p, end, vn[i]);
+            chunk.normal.push_back(vn);
+        } else if (len >= 2 && line[0] == 'f' && line[1] == ' ') {
+            chunk.face_offsets.push_back(chunk.vert_index.size());
             int idx, vt_idx, vn_idx;
-            iss >> trash;
-            while (iss >> idx >> trash >> vt_idx >> trash >> vn_idx) {
-                idx--; // -- car indice commence à 1
-                vt_idx--;
-                vn_idx--;
-                f.push_back(idx);
-                vt_indices.push_back(vt_idx);
-                vn_indices.push_back(vn_idx);
+            p += 2;
+            while (parse_number(p, end, idx) && skip_char(p, end) && parse_number(p, end, vt_idx)
+                   && skip_char(p, end) && parse_number(p, end, vn_idx)) {
+                size_t pos = chunk.vert_index.size();
+                chunk.vert_index.push_back(resolve_index(idx, chunk.verts.size(), chunk.fixups[0], pos));
+                chunk.texture_index.push_back(resolve_index(vt_idx, chunk.texture.size(), chunk.fixups[1], pos));
+                chunk.normal_index.push_back(resolve_index(vn_idx, chunk.normal.size(), chunk.fixups[2], pos));
             }
-            faces_.push_back(f);
-            texture_index_.push_back(vt_indices); // On stocke les indices des coordonnées de texture pour cette face
-            normal_index_.push_back(vn_indices); // On stocke les indices des coordonnées de normale pour cette face
         }
+        line = end + 1;
     }
-    std::cerr << "# v# " << verts_.size() << " f# "  << faces_.size() << " vt# " << texture_.size() << " vn# " << normal_.size() << std::endl;
 }
 
-Model::~Model() {
+// Taille minimale d'un morceau pour qu'il vaille la peine d'être lu sur son propre thread
+const size_t OBJ_MIN_CHUNK = 1 << 16;
+
+Model::Model(const char *filename, int nthreads, bool use_cache) {
+    // Le cache binaire est à côté du fichier OBJ, il est créé à la première lecture du fichier.
+    // S'il est à jour, les tableaux du modèle sont directement ceux du fichier projeté.
+    std::string cache_path = std::string(filename) + ".mesh";
+    if (use_cache && cache_.open(cache_path.c_str(), filename)) {
+        arrays_ = cache_.arrays();
+    } else {
+        if (!read_obj(filename, nthreads)) return;
+
+        // Vue SoA des positions pour la transformation SIMD des sommets
+        verts_x_.resize(verts_.size());
+        verts_y_.resize(verts_.size());
+        verts_z_.resize(verts_.size());
+        for (size_t i=0; i<verts_.size(); i++) {
+            verts_x_[i] = verts_[i].x;
+            verts_y_[i] = verts_[i].y;
+            verts_z_[i] = verts_[i].z;
+        }
+
+        arrays_.verts = verts_.data();
+        arrays_.verts_x = verts_x_.data();
+        arrays_.verts_y = verts_y_.data();
+        arrays_.verts_z = verts_z_.data();
+        arrays_.texture = texture_.data();
+        arrays_.normal = normal_.data();
+        arrays_.face_offsets = face_offsets_.data();
+        arrays_.vert_index = vert_index_.data();
+        arrays_.texture_index = texture_index_.data();
+        arrays_.normal_index = normal_index_.data();
+        arrays_.nverts = verts_.size();
+        arrays_.ntexture = texture_.size();
+        arrays_.nnormal = normal_.size();
+        arrays_.nfaces = face_offsets_.size() - 1;
+        if (use_cache && !write_mesh_cache(cache_path.c_str(), filename, arrays_))
+            std::cerr << "can't write mesh cache " << cache_path << std::endl;
+    }
+    std::cerr << "# v# " << arrays_.nverts << " f# "  << arrays_.nfaces << " vt# " << arrays_.ntexture << " vn# " << arrays_.nnormal << std::endl;
+}
+
+bool Model::read_obj(const char *filename, int nthreads) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    size_t size = st.st_size;
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return false;
+    madvise(map, size, MADV_SEQUENTIAL);
+    const char *data = (const char *)map;
+
+    // Découpage en nchunks morceaux à peu près égaux, chaque coupure avancée jusqu'au début de ligne suivant
+    int nchunks = (int)std::max<size_t>(1, std::min<size_t>(std::max(1, nthreads), size / OBJ_MIN_CHUNK));
+    std::vector<const char *> cuts(nchunks + 1, data + size);
+    cuts[0] = data;
+    for (int k = 1; k < nchunks; k++) {
+        const char *p = std::max(cuts[k-1], data + size * k / nchunks);
+        if (p > data && p[-1] != '\n') {
+            const char *nl = (const char *)memchr(p, '\n', data + size - p);
+            p = nl ? nl + 1 : data + size;
+        }
+        cuts[k] = p;
+    }
+
+    std::vector<ObjChunk> chunks(nchunks);
+    if (nchunks == 1) {
+        parse_chunk(data, data + size, chunks[0]);
+    } else {
+        std::vector<std::thread> pool;
+        for (int k = 0; k < nchunks; k++)
+            pool.push_back(std::thread(parse_chunk, cuts[k], cuts[k+1], std::ref(chunks[k])));
+        for (std::thread &th : pool) th.join();
+    }
+    munmap(map, size);
+
+    // Somme préfixe des nombres de v, vt, vn, f et d'indices de chaque morceau : position du
+    // morceau dans les tableaux du modèle et décalage de ses indices relatifs
+    std::vector<size_t> first_vert(nchunks + 1, 0), first_texture(nchunks + 1, 0), first_normal(nchunks + 1, 0);
+    std::vector<size_t> first_face(nchunks + 1, 0), first_index(nchunks + 1, 0);
+    for (int k = 0; k < nchunks; k++) {
+        first_vert[k+1] = first_vert[k] + chunks[k].verts.size();
+        first_texture[k+1] = first_texture[k] + chunks[k].texture.size();
+        first_normal[k+1] = first_normal[k] + chunks[k].normal.size();
+        first_face[k+1] = first_face[k] + chunks[k].face_offsets.size();
+        first_index[k+1] = first_index[k] + chunks[k].vert_index.size();
+    }
+    verts_.resize(first_vert[nchunks]);
+    texture_.resize(first_texture[nchunks]);
+    normal_.resize(first_normal[nchunks]);
+    face_offsets_.resize(first_face[nchunks] + 1);
+    vert_index_.resize(first_index[nchunks]);
+    texture_index_.resize(first_index[nchunks]);
+    normal_index_.resize(first_index[nchunks]);
+    for (int k = 0; k < nchunks; k++) {
+        ObjChunk &chunk = chunks[k];
+        for (uint32_t pos : chunk.fixups[0]) chunk.vert_index[pos] += first_vert[k];
+        for (uint32_t pos : chunk.fixups[1]) chunk.texture_index[pos] += first_texture[k];
+        for (uint32_t pos : chunk.fixups[2]) chunk.normal_index[pos] += first_normal[k];
+        for (size_t i = 0; i < chunk.face_offsets.size(); i++)
+            face_offsets_[first_face[k] + i] = chunk.face_offsets[i] + first_index[k];
+        std::copy(chunk.verts.begin(), chunk.verts.end(), verts_.begin() + first_vert[k]);
+        std::copy(chunk.texture.begin(), chunk.texture.end(), texture_.begin() + first_texture[k]);
+        std::copy(chunk.normal.begin(), chunk.normal.end(), normal_.begin() + first_normal[k]);
+        std::copy(chunk.vert_index.begin(), chunk.vert_index.end(), vert_index_.begin() + first_index[k]);
+        std::copy(chunk.texture_index.begin(), chunk.texture_index.end(), texture_index_.begin() + first_index[k]);
+        std::copy(chunk.normal_index.begin(), chunk.normal_index.end(), normal_index_.begin() + first_index[k]);
+    }
+    face_offsets_[first_face[nchunks]] = first_index[nchunks];
+    return true;
 }
 
-int Model::nverts() {
-    return (int)verts_.size();
+Model::~Model() {
 }
 
-int Model::nfaces() {
-    return (int)faces_.size();
+// Clé de la table de hachage des triplets (v, vt, vn)
+struct CornerKey {
+    uint32_t v, vt, vn;
+    bool operator==(const CornerKey &o) const { return v == o.v && vt == o.vt && vn == o.vn; }
+};
+
+struct CornerHash {
+    size_t operator()(const CornerKey &k) const {
+        uint64_t h = k.v * 0x9E3779B97F4A7C15ull;
+        h ^= (h >> 29) + k.vt * 0xBF58476D1CE4E5B9ull;
+        h ^= (h >> 31) + k.vn * 0x94D049BB133111EBull;
+        return h ^ (h >> 32);
+    }
+};
+
+void Model::build_vertex_buffer() {
+    size_t nindices = arrays_.nindices();
+    vertices_.clear();
+    vertex_index_.resize(nindices);
+    std::unordered_map<CornerKey, uint32_t, CornerHash> unique;
+    unique.reserve(arrays_.nverts + arrays_.ntexture);
+    for (size_t i = 0; i < nindices; i++) {
+        CornerKey key = { arrays_.vert_index[i], arrays_.texture_index[i], arrays_.normal_index[i] };
+        auto it = unique.emplace(key, (uint32_t)vertices_.size());
+        if (it.second) {
+            Vertex v;
+            v.position = arrays_.verts[key.v];
+            v.uv = arrays_.texture[key.vt];
+            v.normal = arrays_.normal[key.vn];
+            vertices_.push_back(v);
+        }
+        vertex_index_[i] = it.first->second;
+    }
+
+    // Tangentes : somme sur les triangles (en éventail pour les polygones) de la direction des
+    // u croissants, puis projection orthogonale à la normale du sommet
+    std::vector<Vec3f> tangents(vertices_.size());
+    for (size_t f = 0; f < arrays_.nfaces; f++) {
+        const uint32_t *idx = vertex_index_.data() + arrays_.face_offsets[f];
+        int n = arrays_.face_offsets[f+1] - arrays_.face_offsets[f];
+        for (int k = 1; k + 1 < n; k++) {
+            const Vertex &a = vertices_[idx[0]], &b = vertices_[idx[k]], &c = vertices_[idx[k+1]];
+            Vec3f e1 = b.position - a.position, e2 = c.position - a.position;
+            Vec2f d1 = b.uv - a.uv, d2 = c.uv - a.uv;
+            float det = d1.x*d2.y - d2.x*d1.y;
+            if (std::fabs(det) < 1e-12f) continue;
+            Vec3f t = (e1*d2.y - e2*d1.y) * (1.f/det);
+            tangents[idx[0]] = tangents[idx[0]] + t;
+            tangents[idx[k]] = tangents[idx[k]] + t;
+            tangents[idx[k+1]] = tangents[idx[k+1]] + t;
+        }
+    }
+    for (size_t i = 0; i < vertices_.size(); i++) {
+        Vec3f n = vertices_[i].normal;
+        Vec3f t = tangents[i] - n*(n*tangents[i]);
+        if (t.norm() < 1e-12f) t = std::fabs(n.x) < .9f ? Vec3f(1, 0, 0) ^ n : Vec3f(0, 1, 0) ^ n; // uv dégénérées
+        vertices_[i].tangent = t.normalize();
+    }
+    std::cerr << "# vertices " << vertices_.size() << " for " << nindices << " face corners" << std::endl;
 }
 
-std::vector<int> Model::face(int idx) {
-    return faces_[idx];
+// Score d'un sommet pour l'algorithme de Forsyth : position dans le cache (les sommets de la
+// dernière face ont un score fixe, les autres d'autant plus fort qu'ils sont récents) plus un
+// bonus pour les sommets à qui il reste peu de faces, à finir avant qu'ils ne sortent du cache
+static float forsyth_score(int cache_pos, int remaining, int cache_size) {
+    if (remaining == 0) return -1.f;
+    float score = 0.f;
+    if (cache_pos >= 0) {
+        if (cache_pos < 3) score = .75f;
+        else score = std::pow(1.f - float(cache_pos - 3) / (cache_size - 3), 1.5f);
+    }
+    return score + 2.f / std::sqrt(float(remaining));
 }
 
-Vec3f Model::vert(int i) {
-    return verts_[i];
+void Model::optimize_face_order(int cache_size) {
+    const int nfaces = (int)arrays_.nfaces;
+    const int nvertices = (int)vertices_.size();
+    const uint32_t *offsets = arrays_.face_offsets;
+    if (nfaces == 0 || cache_size <= 3) return;
+
+    // Faces de chaque sommet
+    std::vector<int> remaining(nvertices, 0);
+    for (uint32_t v : vertex_index_) remaining[v]++;
+    std::vector<int> vertex_faces_start(nvertices + 1, 0);
+    for (int v = 0; v < nvertices; v++) vertex_faces_start[v+1] = vertex_faces_start[v] + remaining[v];
+    std::vector<int> vertex_faces(vertex_faces_start[nvertices]);
+    std::vector<int> fill(vertex_faces_start.begin(), vertex_faces_start.end() - 1);
+    for (int f = 0; f < nfaces; f++)
+        for (uint32_t c = offsets[f]; c < offsets[f+1]; c++) vertex_faces[fill[vertex_index_[c]]++] = f;
+
+    std::vector<int> cache_pos(nvertices, -1);
+    std::vector<float> vertex_score(nvertices);
+    for (int v = 0; v < nvertices; v++) vertex_score[v] = forsyth_score(-1, remaining[v], cache_size);
+    std::vector<float> face_score(nfaces, 0.f);
+    for (int f = 0; f < nfaces; f++)
+        for (uint32_t c = offsets[f]; c < offsets[f+1]; c++) face_score[f] += vertex_score[vertex_index_[c]];
+    std::vector<bool> emitted(nfaces, false);
+
+    std::vector<int> order;
+    order.reserve(nfaces);
+    std::vector<int> cache, next_cache; // sommets du cache simulé, du plus récent au plus ancien
+    int best = std::max_element(face_score.begin(), face_score.end()) - face_score.begin();
+    int scan = 0; // toutes les faces avant scan ont été émises
+    while ((int)order.size() < nfaces) {
+        if (best < 0) {
+            // Aucune face ne touche le cache : meilleure face restante
+            while (emitted[scan]) scan++;
+            best = scan;
+            for (int f = scan; f < nfaces; f++)
+                if (!emitted[f] && face_score[f] > face_score[best]) best = f;
+        }
+        emitted[best] = true;
+        order.push_back(best);
+
+        // Les sommets de la face passent en tête du cache, les autres reculent
+        next_cache.clear();
+        for (uint32_t c = offsets[best]; c < offsets[best+1]; c++) {
+            int v = vertex_index_[c];
+            if (std::find(next_cache.begin(), next_cache.end(), v) == next_cache.end()) next_cache.push_back(v);
+            remaining[v]--;
+        }
+        for (int v : cache)
+            if (std::find(next_cache.begin(), next_cache.end(), v) == next_cache.end()) next_cache.push_back(v);
+        for (size_t i = cache_size; i < next_cache.size(); i++) cache_pos[next_cache[i]] = -1; // sortis du cache
+        if ((int)next_cache.size() > cache_size) next_cache.resize(cache_size);
+        std::swap(cache, next_cache);
+
+        // Mise à jour des scores des sommets du cache (et des sortis) puis de leurs faces
+        for (int i = 0; i < (int)cache.size(); i++) cache_pos[cache[i]] = i;
+        best = -1;
+        float best_score = -1e30f;
+        auto rescore = [&](int v) {
+            float score = forsyth_score(cache_pos[v], remaining[v], cache_size);
+            float delta = score - vertex_score[v];
+            vertex_score[v] = score;
+            for (int i = vertex_faces_start[v]; i < vertex_faces_start[v+1]; i++) {
+                int f = vertex_faces[i];
+                if (emitted[f]) continue;
+                face_score[f] += delta;
+            }
+        };
+        for (int v : next_cache) if (cache_pos[v] < 0) rescore(v);
+        for (int v : cache) rescore(v);
+        for (int v : cache)
+            for (int i = vertex_faces_start[v]; i < vertex_faces_start[v+1]; i++) {
+                int f = vertex_faces[i];
+                if (!emitted[f] && face_score[f] > best_score) {
+                    best_score = face_score[f];
+                    best = f;
+                }
+            }
+    }
+
+    reorder_faces(order);
 }
 
-Vec2f Model::texture(int i) {
-    return texture_[i];
+// Permutation des faces dans tous les tableaux d'indices : la face i devient l'ancienne face order[i].
+// Les nouveaux indices sont rangés dans les vecteurs du modèle ; les positions, uv et normales
+// restent où elles sont, y compris dans le cache projeté.
+void Model::reorder_faces(const std::vector<int> &order) {
+    const int nfaces = (int)order.size();
+    const size_t nindices = arrays_.nindices();
+    const uint32_t *offsets = arrays_.face_offsets;
+    std::vector<uint32_t> new_offsets(nfaces + 1, 0);
+    std::vector<uint32_t> new_vert(nindices), new_texture(nindices), new_normal(nindices), new_vertex(nindices);
+    for (int i = 0; i < nfaces; i++) {
+        int f = order[i];
+        uint32_t n = offsets[f+1] - offsets[f];
+        new_offsets[i+1] = new_offsets[i] + n;
+        std::copy_n(arrays_.vert_index + offsets[f], n, new_vert.begin() + new_offsets[i]);
+        std::copy_n(arrays_.texture_index + offsets[f], n, new_texture.begin() + new_offsets[i]);
+        std::copy_n(arrays_.normal_index + offsets[f], n, new_normal.begin() + new_offsets[i]);
+        std::copy_n(vertex_index_.begin() + offsets[f], n, new_vertex.begin() + new_offsets[i]);
+    }
+    face_offsets_.swap(new_offsets);
+    vert_index_.swap(new_vert);
+    texture_index_.swap(new_texture);
+    normal_index_.swap(new_normal);
+    vertex_index_.swap(new_vertex);
+    arrays_.face_offsets = face_offsets_.data();
+    arrays_.vert_index = vert_index_.data();
+    arrays_.texture_index = texture_index_.data();
+    arrays_.normal_index = normal_index_.data();
 }
 
-int Model::texture_index(int face_idx, int vert_idx) {
-    // Renvoie l'indice de la coordonnée de texture pour le vert_idx-ème sommet de la face_idx-ème face
-    return texture_index_[face_idx][vert_idx]; // Modifiez l'index du vecteur texture_index_
+float Model::acmr(int cache_size) const {
+    std::vector<int> fifo(cache_size, -1);
+    int next = 0;
+    long misses = 0, ntriangles = 0;
+    for (size_t f = 0; f < arrays_.nfaces; f++) {
+        ntriangles += std::max(0, int(arrays_.face_offsets[f+1] - arrays_.face_offsets[f]) - 2);
+        for (uint32_t c = arrays_.face_offsets[f]; c < arrays_.face_offsets[f+1]; c++) {
+            int v = vertex_index_[c];
+            if (std::find(fifo.begin(), fifo.end(), v) != fifo.end()) continue;
+            fifo[next] = v;
+            next = (next + 1) % cache_size;
+            misses++;
+        }
+    }
+    return ntriangles ? float(misses) / ntriangles : 0.f;
 }
 
-Vec3f Model::normal(int i) {
-    return normal_[i];
+// Sphère englobante et cône des normales des faces du meshlet m
+static void meshlet_bounds(const Model &model, Meshlet &m) {
+    Vec3f lo(1e30f, 1e30f, 1e30f), hi(-1e30f, -1e30f, -1e30f);
+    for (int f = m.first_face; f < m.first_face + m.nfaces; f++)
+        for (int v : model.face_vertices(f)) {
+            Vec3f p = model.vertex(v).position;
+            lo = Vec3f(std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z));
+            hi = Vec3f(std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z));
+        }
+    m.center = (lo + hi) * .5f;
+    m.radius = 0;
+    for (int f = m.first_face; f < m.first_face + m.nfaces; f++)
+        for (int v : model.face_vertices(f)) m.radius = std::max(m.radius, (model.vertex(v).position - m.center).norm());
+
+    // Normales géométriques des faces (même orientation que FlatShader)
+    std::vector<Vec3f> normals;
+    Vec3f axis(0, 0, 0);
+    for (int f = m.first_face; f < m.first_face + m.nfaces; f++) {
+        FaceIndices face = model.face_vertices(f);
+        Vec3f p0 = model.vertex(face[0]).position;
+        Vec3f n = (model.vertex(face[1]).position - p0) ^ (model.vertex(face[2]).position - p0);
+        if (n.norm() < 1e-20f) continue; // face dégénérée, sans orientation
+        normals.push_back(n.normalize());
+        axis = axis + normals.back();
+    }
+    m.cone_axis = Vec3f(0, 0, 1);
+    m.cone_cutoff = 1;
+    if (normals.empty() || axis.norm() < 1e-6f) return;
+    m.cone_axis = axis.normalize();
+    float min_dot = 1;
+    for (const Vec3f &n : normals) min_dot = std::min(min_dot, n * m.cone_axis);
+    // Toutes les normales sont à moins de acos(min_dot) de l'axe : les faces sont toutes de dos si
+    // la direction de vue fait un angle de moins de 90° - acos(min_dot) avec l'axe
+    if (min_dot > 0) m.cone_cutoff = std::sqrt(1 - min_dot*min_dot);
 }
 
-int Model::normal_index(int face_idx, int vert_idx) {
-    // Renvoie l'indice de la coordonnée de normale pour le vert_idx-ème sommet de la face_idx-ème face.
-    return normal_index_[face_idx][vert_idx]; // Modifiez l'index du vecteur normal_index_
-}
\ No newline at end of file
+void Model::build_meshlets(int max_vertices, int max_triangles, float cone_cos) {
+    const int nfaces = (int)arrays_.nfaces;
+    const uint32_t *offsets = arrays_.face_offsets;
+    meshlets_.clear();
+
+    // Normale de chaque face et faces de chaque position (les coutures d'uv ne coupent pas l'adjacence)
+    std::vector<Vec3f> normals(nfaces);
+    for (int f = 0; f < nfaces; f++) {
+        FaceIndices face = face_vertices(f);
+        Vec3f p0 = vertex(face[0]).position;
+        Vec3f n = (vertex(face[1]).position - p0) ^ (vertex(face[2]).position - p0);
+        normals[f] = n.norm() < 1e-20f ? Vec3f(0, 0, 0) : n.normalize();
+    }
+    std::vector<int> position_faces_start(arrays_.nverts + 1, 0);
+    for (size_t c = 0; c < arrays_.nindices(); c++) position_faces_start[arrays_.vert_index[c] + 1]++;
+    for (size_t v = 0; v < arrays_.nverts; v++) position_faces_start[v+1] += position_faces_start[v];
+    std::vector<int> position_faces(position_faces_start[arrays_.nverts]);
+    std::vector<int> fill(position_faces_start.begin(), position_faces_start.end() - 1);
+    for (int f = 0; f < nfaces; f++)
+        for (uint32_t c = offsets[f]; c < offsets[f+1]; c++) position_faces[fill[arrays_.vert_index[c]]++] = f;
+
+    // Chaque meshlet part de la première face libre dans l'ordre actuel et grossit par les faces voisines
+    // qui ajoutent le moins de sommets, en préférant celles dont la normale est proche de l'axe du meshlet.
+    // Les faces trop écartées de l'axe sont refusées : un cône trop ouvert ne permet jamais d'écarter le meshlet.
+    std::vector<int> meshlet_of(nfaces, -1);
+    std::vector<int> used(vertices_.size(), -1); // meshlet qui utilise déjà chaque sommet
+    std::vector<int> order;
+    order.reserve(nfaces);
+    int seed = 0;
+    while (true) {
+        while (seed < nfaces && meshlet_of[seed] >= 0) seed++;
+        if (seed == nfaces) break;
+        const int id = (int)meshlets_.size();
+        std::vector<int> faces;
+        Vec3f axis(0, 0, 0);
+        int nvertices = 0, ntriangles = 0;
+        int next = seed;
+        while (next >= 0) {
+            meshlet_of[next] = id;
+            faces.push_back(next);
+            for (int v : face_vertices(next))
+                if (used[v] != id) {
+                    used[v] = id;
+                    nvertices++;
+                }
+            ntriangles += std::max(0, int(offsets[next+1] - offsets[next]) - 2);
+            axis = axis + normals[next];
+            Vec3f dir = axis.norm() > 1e-6f ? Vec3f(axis).normalize() : Vec3f(0, 0, 0);
+
+            // Meilleure face libre qui touche le meshlet et tient dans les limites
+            next = -1;
+            float best_score = 1e30f;
+            for (int f : faces)
+                for (uint32_t c = offsets[f]; c < offsets[f+1]; c++) {
+                    int p = arrays_.vert_index[c];
+                    for (int i = position_faces_start[p]; i < position_faces_start[p+1]; i++) {
+                        int g = position_faces[i];
+                        if (meshlet_of[g] >= 0) continue;
+                        int new_vertices = 0;
+                        for (int v : face_vertices(g)) new_vertices += used[v] != id;
+                        int triangles = std::max(0, int(offsets[g+1] - offsets[g]) - 2);
+                        if (nvertices + new_vertices > max_vertices || ntriangles + triangles > max_triangles) continue;
+                        if (normals[g]*dir < cone_cos) continue;
+                        float score = new_vertices + 2.f*(1.f - normals[g]*dir);
+                        if (score < best_score) {
+                            best_score = score;
+                            next = g;
+                        }
+                    }
+                }
+        }
+
+        // Les faces du meshlet gardent entre elles leur ordre précédent
+        std::sort(faces.begin(), faces.end());
+        Meshlet m = Meshlet();
+        m.first_face = (int)order.size();
+        m.nfaces = (int)faces.size();
+        order.insert(order.end(), faces.begin(), faces.end());
+        meshlets_.push_back(m);
+    }
+    reorder_faces(order);
+    for (Meshlet &m : meshlets_) meshlet_bounds(*this, m);
+}
@@ -2,27 +2,103 @@
 #define __MODEL_H__
 
 #include <vector>
+#include <cstdint>
 #include "geometry.h"
+#include "meshcache.h"
+
+// Indices d'une face, lus directement dans le tableau plat du modèle (sans copie)
+struct FaceIndices {
+	const uint32_t *indices;
+	int n;
+	int size() const { return n; }
+	int operator[](int i) const { return indices[i]; }
+	const uint32_t *begin() const { return indices; }
+	const uint32_t *end() const { return indices + n; }
+};
+
+// Sommet entrelacé du tampon de sommets : un par triplet (v, vt, vn) distinct des faces
+struct Vertex {
+	Vec3f position;
+	Vec2f uv;
+	Vec3f normal;
+	Vec3f tangent; // direction des u croissants, orthogonale à la normale
+};
+
+// Groupe de faces consécutives (meshlet) avec de quoi l'écarter en bloc avant l'étage de sommets
+struct Meshlet {
+	int first_face, nfaces;
+	Vec3f center;       // sphère englobante
+	float radius;
+	Vec3f cone_axis;    // cône contenant les normales des faces
+	float cone_cutoff;  // sinus du demi-angle du cône, 1 si le cône est trop ouvert pour être utile
+};
 
 class Model {
 private:
+	// Tableaux remplis par la lecture du fichier OBJ, vides si le modèle vient du cache
+	// (sauf les tableaux d'indices, remplis dès que les faces sont réordonnées)
 	std::vector<Vec3f> verts_;
-	std::vector<std::vector<int> > faces_;
+	std::vector<float> verts_x_, verts_y_, verts_z_; // copie de verts_ en structure de tableaux
 	std::vector<Vec2f> texture_;
-	std::vector<std::vector<int>> texture_index_;
 	std::vector<Vec3f> normal_;
-	std::vector<std::vector<int>> normal_index_;
+	std::vector<uint32_t> face_offsets_; // la face i occupe [face_offsets_[i], face_offsets_[i+1]) des tableaux d'indices
+	std::vector<uint32_t> vert_index_, texture_index_, normal_index_;
+	MeshCache cache_;
+	MeshArrays arrays_; // vue sur les tableaux ci-dessus ou sur le cache projeté
+	std::vector<Vertex> vertices_;
+	std::vector<uint32_t> vertex_index_; // indice dans vertices_ de chaque coin de face, même découpage que vert_index_
+	std::vector<Meshlet> meshlets_;
+	bool read_obj(const char *filename, int nthreads);
+	void reorder_faces(const std::vector<int> &order);
 public:
-	Model(const char *filename);
+	// nthreads : nombre de threads de lecture du fichier OBJ. Avec use_cache, le modèle est relu
+	// depuis le cache binaire filename.mesh s'il est à jour, sinon ce cache est (ré)écrit.
+	Model(const char *filename, int nthreads = 1, bool use_cache = true);
 	~Model();
-	int nverts();
-	int nfaces();
-	Vec3f vert(int i);
-	std::vector<int> face(int idx);
-	Vec2f texture(int i);
-	int texture_index(int face_idx, int vert_idx);
-	Vec3f normal(int i);
-	int normal_index(int face_idx, int vert_idx);
+	int nverts() const { return (int)arrays_.nverts; }
+	int nfaces() const { return (int)arrays_.nfaces; }
+	Vec3f vert(int i) const { return arrays_.verts[i]; }
+	const float *verts_x() const { return arrays_.verts_x; }
+	const float *verts_y() const { return arrays_.verts_y; }
+	const float *verts_z() const { return arrays_.verts_z; }
+	FaceIndices face(int idx) const {
+		uint32_t first = arrays_.face_offsets[idx];
+		return FaceIndices{ arrays_.vert_index + first, int(arrays_.face_offsets[idx+1] - first) };
+	}
+	Vec2f texture(int i) const { return arrays_.texture[i]; }
+	// Indice de la coordonnée de texture du vert_idx-ème sommet de la face_idx-ème face
+	int texture_index(int face_idx, int vert_idx) const { return arrays_.texture_index[arrays_.face_offsets[face_idx] + vert_idx]; }
+	Vec3f normal(int i) const { return arrays_.normal[i]; }
+	// Indice de la normale du vert_idx-ème sommet de la face_idx-ème face
+	int normal_index(int face_idx, int vert_idx) const { return arrays_.normal_index[arrays_.face_offsets[face_idx] + vert_idx]; }
+
+	// Passe optionnelle après le chargement : chaque triplet (v, vt, vn) distinct devient un seul
+	// sommet entrelacé (position, uv, normale, tangente), les faces n'ont plus qu'un indice par coin
+	void build_vertex_buffer();
+	int nvertices() const { return (int)vertices_.size(); }
+	const Vertex &vertex(int i) const { return vertices_[i]; }
+	FaceIndices face_vertices(int idx) const {
+		uint32_t first = arrays_.face_offsets[idx];
+		return FaceIndices{ vertex_index_.data() + first, int(arrays_.face_offsets[idx+1] - first) };
+	}
+	// Position du premier coin de la face idx dans les tableaux d'indices (coins rangés face après face)
+	int face_offset(int idx) const { return arrays_.face_offsets[idx]; }
+	int ncorners() const { return (int)arrays_.nindices(); }
+
+	// Réordonne les faces pour qu'un cache post-transformation de cache_size sommets serve le plus
+	// souvent possible (algorithme de Forsyth, "Linear-Speed Vertex Cache Optimisation").
+	// Demande le tampon de sommets.
+	void optimize_face_order(int cache_size);
+	// Nombre moyen de sommets transformés par triangle avec un cache FIFO de cache_size sommets
+	float acmr(int cache_size) const;
+
+	// Regroupe les faces voisines en meshlets d'au plus max_vertices sommets et max_triangles triangles,
+	// dont les normales font un cosinus d'au moins cone_cos avec l'axe du meshlet. Les faces sont
+	// réordonnées pour que chaque meshlet soit une suite de faces consécutives.
+	// Demande le tampon de sommets, à refaire si l'ordre des faces change.
+	void build_meshlets(int max_vertices, int max_triangles, float cone_cos);
+	int nmeshlets() const { return (int)meshlets_.size(); }
+	const Meshlet &meshlet(int i) const { return meshlets_[i]; }
 };
 
 #endif //__MODEL_H__
@@ -0,0 +1,239 @@
+#ifndef __RASTERIZER_H__
+#define __RASTERIZER_H__
+
+#include <cmath>
+#include <algorithm>
+#include "geometry.h"
+#include "tgaimage.h"
+#include "tiles.h"
+#include "hiz.h"
+#include "clip.h"
+
+// Précision sous-pixel des sommets : les coordonnées écran sont arrondies en virgule fixe 24.8
+const int SUBPIXEL_BITS = 8;
+const int SUBPIXEL_ONE  = 1 << SUBPIXEL_BITS;
+
+// Pixel entier à gauche (ou au-dessus) d'une coordonnée en virgule fixe, négative comprise :
+// la division entière tronque vers 0 et le décalage à droite d'un négatif dépend du compilateur
+inline long long subpixel_floor(long long v) {
+    return v >= 0 ? v / SUBPIXEL_ONE : -((SUBPIXEL_ONE - 1 - v) / SUBPIXEL_ONE);
+}
+
+// Faces écartées à la préparation du triangle selon leur orientation à l'écran
+// (les faces de face sont celles dont les sommets tournent dans le sens trigonométrique à l'écran)
+enum CullMode { CULL_NONE, CULL_BACK, CULL_FRONT };
+
+// Fonctions d'arête entières du triangle, préparées une seule fois par triangle.
+// w0, w1, w2 sont non négatifs quand le pixel est couvert, on passe d'un pixel
+// au suivant en ajoutant une constante.
+// Règle de remplissage haut-gauche : un pixel situé exactement sur une arête n'est
+// couvert que si l'arête est à gauche (ou en haut) du triangle, ainsi un pixel sur
+// une arête partagée par deux triangles n'est dessiné qu'une seule fois.
+// Les coordonnées barycentriques sont des plans calculés à partir des sommets
+// flottants : alpha = alpha_x*x + alpha_y*y + alpha_c, sans division par pixel.
+// L'aire signée n'est calculée qu'une fois : les triangles dégénérés et ceux écartés
+// par le mode cull sont rejetés avant la boîte englobante.
+struct EdgeSetup {
+    int minx, miny, maxx, maxy;
+    long long w0_row, w1_row, w2_row; // valeurs au pixel (minx, miny)
+    long long a0, a1, a2;             // pas en x
+    long long b0, b1, b2;             // pas en y
+    float alpha_x, alpha_y, alpha_c;
+    float beta_x, beta_y, beta_c;
+    float z_x, z_y, z_c, z_error;      // plan de la profondeur et erreur d'arrondi maximale
+
+    static long long top_left_bias(long long a, long long b) {
+        return (a > 0 || (a == 0 && b < 0)) ? 0 : -1;
+    }
+
+    bool setup(const Vec3f *pts, const TileRect &clip, CullMode cull) {
+        long long vx[3], vy[3];
+        for (int i = 0; i < 3; i++) {
+            vx[i] = std::lround(pts[i].x * SUBPIXEL_ONE);
+            vy[i] = std::lround(pts[i].y * SUBPIXEL_ONE);
+        }
+        long long area = (vx[1]-vx[0])*(vy[2]-vy[0]) - (vx[2]-vx[0])*(vy[1]-vy[0]);
+        if (area == 0) return false;
+        if ((cull == CULL_BACK && area < 0) || (cull == CULL_FRONT && area > 0)) return false;
+        int sign = area > 0 ? 1 : -1;
+
+        // Pixels dont le centre (coordonnées entières) est dans la boîte englobante
+        minx = int(subpixel_floor(std::min(vx[0], std::min(vx[1], vx[2])) + SUBPIXEL_ONE - 1));
+        miny = int(subpixel_floor(std::min(vy[0], std::min(vy[1], vy[2])) + SUBPIXEL_ONE - 1));
+        maxx = int(subpixel_floor(std::max(vx[0], std::max(vx[1], vx[2]))));
+        maxy = int(subpixel_floor(std::max(vy[0], std::max(vy[1], vy[2]))));
+        // On ne parcourt que la partie de la boîte dans la zone de dessin (tuile ou écran)
+        minx = std::max(minx, clip.x0); maxx = std::min(maxx, clip.x1);
+        miny = std::max(miny, clip.y0); maxy = std::min(maxy, clip.y1);
+        if (minx > maxx || miny > maxy) return false;
+
+        // w_i s'annule sur l'arête opposée au sommet i
+        long long ea0 = sign*(vy[1]-vy[2]), eb0 = sign*(vx[2]-vx[1]);
+        long long ea1 = sign*(vy[2]-vy[0]), eb1 = sign*(vx[0]-vx[2]);
+        long long ea2 = sign*(vy[0]-vy[1]), eb2 = sign*(vx[1]-vx[0]);
+        long long px = (long long)minx * SUBPIXEL_ONE;
+        long long py = (long long)miny * SUBPIXEL_ONE;
+        w0_row = ea0*(px-vx[2]) + eb0*(py-vy[2]) + top_left_bias(ea0, eb0);
+        w1_row = ea1*(px-vx[2]) + eb1*(py-vy[2]) + top_left_bias(ea1, eb1);
+        w2_row = ea2*(px-vx[0]) + eb2*(py-vy[0]) + top_left_bias(ea2, eb2);
+        a0 = ea0 * SUBPIXEL_ONE; b0 = eb0 * SUBPIXEL_ONE;
+        a1 = ea1 * SUBPIXEL_ONE; b1 = eb1 * SUBPIXEL_ONE;
+        a2 = ea2 * SUBPIXEL_ONE; b2 = eb2 * SUBPIXEL_ONE;
+
+        const Vec3f &A = pts[0], &B = pts[1], &C = pts[2];
+        float inv_area = 1.f/((B.x - A.x) * (C.y - A.y) - (C.x - A.x) * (B.y - A.y));
+        alpha_x = (B.y - C.y)*inv_area;
+        alpha_y = (C.x - B.x)*inv_area;
+        alpha_c = -(alpha_x*C.x + alpha_y*C.y);
+        beta_x  = (C.y - A.y)*inv_area;
+        beta_y  = (A.x - C.x)*inv_area;
+        beta_c  = -(beta_x*C.x + beta_y*C.y);
+
+        // z = C.z + (A.z-C.z)*alpha + (B.z-C.z)*beta
+        z_x = (A.z - C.z)*alpha_x + (B.z - C.z)*beta_x;
+        z_y = (A.z - C.z)*alpha_y + (B.z - C.z)*beta_y;
+        z_c = C.z + (A.z - C.z)*alpha_c + (B.z - C.z)*beta_c;
+        float X = std::max(std::abs(minx), std::abs(maxx)), Y = std::max(std::abs(miny), std::abs(maxy));
+        z_error = 1e-5f * (1.f + std::abs(A.z) + std::abs(B.z) + std::abs(C.z))
+                * (1.f + std::abs(alpha_x)*X + std::abs(alpha_y)*Y + std::abs(alpha_c)
+                       + std::abs(beta_x)*X  + std::abs(beta_y)*Y  + std::abs(beta_c));
+        return true;
+    }
+
+    // Profondeur la plus proche que le triangle peut atteindre sur le rectangle [x0,x1]x[y0,y1]
+    float nearest_depth(int x0, int y0, int x1, int y1) const {
+        return z_c + std::max(z_x*x0, z_x*x1) + std::max(z_y*y0, z_y*y1) + z_error;
+    }
+
+    Vec3f barycentric(int x, int y) const {
+        float alpha = alpha_x*x + alpha_y*y + alpha_c;
+        float beta  = beta_x*x + beta_y*y + beta_c;
+        return Vec3f(alpha, beta, 1.f - alpha - beta);
+    }
+};
+
+// Parcourt le triangle bloc par bloc puis par quads de 2x2 pixels alignés sur les coordonnées paires et
+// appelle fragment(x, y, barycentriques) pour chaque pixel couvert à l'intérieur de clip.
+// Avant les fragments d'un quad, quad(bar00, bar10, bar01) reçoit les barycentriques écran de son pixel
+// haut-gauche et de ses voisins de droite et du dessous, couverts ou non : les différences donnent
+// les dérivées écran de tout attribut interpolé, comme les quads d'un GPU.
+// fragment renvoie true s'il a écrit dans le zbuffer de hiz ; les blocs où le triangle
+// est entièrement derrière le zbuffer sont sautés sans tester un seul pixel.
+template <class Quad, class Fragment> void rasterize_quads(const Vec3f *pts, const TileRect &clip, HiZ &hiz, Quad quad, Fragment fragment,
+                                                           CullMode cull = CULL_NONE) {
+    EdgeSetup e;
+    if (!e.setup(pts, clip, cull)) return;
+    for (int by = e.miny / HIZ_BLOCK; by <= e.maxy / HIZ_BLOCK; by++) {
+        int y0 = std::max(e.miny, by*HIZ_BLOCK), y1 = std::min(e.maxy, by*HIZ_BLOCK + HIZ_BLOCK-1);
+        for (int bx = e.minx / HIZ_BLOCK; bx <= e.maxx / HIZ_BLOCK; bx++) {
+            int x0 = std::max(e.minx, bx*HIZ_BLOCK), x1 = std::min(e.maxx, bx*HIZ_BLOCK + HIZ_BLOCK-1);
+            if (e.nearest_depth(x0, y0, x1, y1) < hiz.farthest(bx, by)) continue;
+
+            bool written = false;
+            int qx0 = x0 & ~1, qy0 = y0 & ~1;
+            long long w0_row = e.w0_row + e.a0*(qx0-e.minx) + e.b0*(qy0-e.miny);
+            long long w1_row = e.w1_row + e.a1*(qx0-e.minx) + e.b1*(qy0-e.miny);
+            long long w2_row = e.w2_row + e.a2*(qx0-e.minx) + e.b2*(qy0-e.miny);
+            for (int qy = qy0; qy <= y1; qy += 2) {
+                long long w0 = w0_row, w1 = w1_row, w2 = w2_row;
+                for (int qx = qx0; qx <= x1; qx += 2) {
+                    // Pixels du quad couverts, ceux hors de [x0,x1]x[y0,y1] ne sont jamais dessinés
+                    int covered = 0;
+                    for (int i = 0; i < 4; i++) {
+                        int dx = i & 1, dy = i >> 1;
+                        int x = qx + dx, y = qy + dy;
+                        long long e0 = w0 + e.a0*dx + e.b0*dy, e1 = w1 + e.a1*dx + e.b1*dy, e2 = w2 + e.a2*dx + e.b2*dy;
+                        if (x >= x0 && x <= x1 && y >= y0 && y <= y1 && (e0 | e1 | e2) >= 0) covered |= 1 << i;
+                    }
+                    if (covered) {
+                        quad(e.barycentric(qx, qy), e.barycentric(qx+1, qy), e.barycentric(qx, qy+1));
+                        for (int i = 0; i < 4; i++) {
+                            if (covered & (1 << i)) written |= fragment(qx + (i & 1), qy + (i >> 1), e.barycentric(qx + (i & 1), qy + (i >> 1)));
+                        }
+                    }
+                    w0 += 2*e.a0; w1 += 2*e.a1; w2 += 2*e.a2;
+                }
+                w0_row += 2*e.b0; w1_row += 2*e.b1; w2_row += 2*e.b2;
+            }
+            if (written) hiz.update(bx, by);
+        }
+    }
+}
+
+// rasterize_quads sans dérivées, pour les passes qui n'échantillonnent pas de texture (carte d'ombre)
+template <class Fragment> void rasterize(const Vec3f *pts, const TileRect &clip, HiZ &hiz, Fragment fragment, CullMode cull = CULL_NONE) {
+    rasterize_quads(pts, clip, hiz, [](Vec3f, Vec3f, Vec3f) {}, fragment, cull);
+}
+
+// Barycentriques corrigées de la perspective : les attributs divisés par w sont affines à l'écran,
+// on pondère donc bar par les 1/w des sommets, avec une seule inversion par pixel
+inline Vec3f perspective_bar(Vec3f bar, const float *inv_w) {
+    float q0 = bar.x*inv_w[0], q1 = bar.y*inv_w[1], q2 = bar.z*inv_w[2];
+    float r = 1.f/(q0 + q1 + q2);
+    return Vec3f(q0*r, q1*r, q2*r);
+}
+
+// Rastérise la face iface de sommets écran pts ou, si l'étage de découpage l'a découpée, les triangles
+// qui en sont issus. fragment(x, y, z, bar) reçoit la profondeur du triangle rastérisé (affine à l'écran)
+// et les coordonnées barycentriques du pixel dans la face d'origine, corrigées de la perspective.
+// quad(dbar_dx, dbar_dy) reçoit avant chaque quad 2x2 les dérivées écran de ces barycentriques.
+// Sans étage de découpage (clipped nul) les barycentriques restent celles de l'écran.
+template <class Quad, class Fragment> void rasterize_face(const Vec3f *pts, int iface, const ClippedFaces *clipped, const TileRect &clip,
+                                                          HiZ &hiz, CullMode cull, Quad quad, Fragment fragment) {
+    if (!clipped || !clipped->is_clipped(iface)) {
+        const float affine[3] = { 1.f, 1.f, 1.f };
+        const float *inv_w = clipped ? clipped->inv_w(iface) : affine;
+        rasterize_quads(pts, clip, hiz, [&](Vec3f b00, Vec3f b10, Vec3f b01) {
+            Vec3f pb = perspective_bar(b00, inv_w);
+            quad(perspective_bar(b10, inv_w) - pb, perspective_bar(b01, inv_w) - pb);
+        }, [&](int x, int y, Vec3f bar) {
+            float z = pts[0].z * bar.x + pts[1].z * bar.y + pts[2].z * bar.z;
+            return fragment(x, y, z, perspective_bar(bar, inv_w));
+        }, cull);
+        return;
+    }
+    for (const ClipTriangle *t = clipped->begin(iface); t != clipped->end(iface); t++) {
+        auto face_bar = [t](Vec3f b) {
+            Vec3f pb = perspective_bar(b, t->inv_w);
+            return t->bar[0]*pb.x + t->bar[1]*pb.y + t->bar[2]*pb.z;
+        };
+        rasterize_quads(t->pts, clip, hiz, [&](Vec3f b00, Vec3f b10, Vec3f b01) {
+            Vec3f pb = face_bar(b00);
+            quad(face_bar(b10) - pb, face_bar(b01) - pb);
+        }, [&](int x, int y, Vec3f b) {
+            float z = t->pts[0].z * b.x + t->pts[1].z * b.y + t->pts[2].z * b.z;
+            return fragment(x, y, z, face_bar(b));
+        }, cull);
+    }
+}
+
+// Dessine la face iface avec un shader connu à la compilation : shader.vertex() donne les
+// coordonnées écran des trois sommets, shader.quad() reçoit les dérivées des barycentriques de
+// chaque quad 2x2, puis shader.fragment() est appelé pour chaque pixel qui passe le test de profondeur.
+// Aucun appel virtuel, le shader est inliné dans la boucle.
+// Le shader est passé par valeur : ses varyings sont propres à l'appel, ce qui permet
+// à plusieurs threads de dessiner avec le même shader. L'image est une vue typée : le format
+// des pixels est connu à la compilation et l'écriture d'un fragment n'est pas vérifiée (clip est
+// dans l'image). Renvoie le nombre de fragments ombrés.
+template <class Shader, class Format> long triangle(Shader shader, int iface, float *zbuffer, ImageView<Format> image, HiZ &hiz,
+                                                    const TileRect &clip, CullMode cull = CULL_NONE, const ClippedFaces *clipped = NULL) {
+    const int width = image.get_width();
+    Vec3f pts[3];
+    for (int j = 0; j < 3; j++) pts[j] = shader.vertex(iface, j);
+    long shaded = 0;
+    rasterize_face(pts, iface, clipped, clip, hiz, cull, [&](Vec3f dbar_dx, Vec3f dbar_dy) {
+        shader.quad(dbar_dx, dbar_dy);
+    }, [&](int x, int y, float z, Vec3f bar) {
+        // On regarde le buffer z est inferieur au z du triangle
+        if (zbuffer[x+y*width] > z) return false;
+        TGAColor color;
+        if (!shader.fragment(x, y, z, bar, color)) return false;
+        zbuffer[x+y*width] = z;
+        image.set(x, y, color);
+        shaded++;
+        return true;
+    });
+    return shaded;
+}
+
+#endif //__RASTERIZER_H__
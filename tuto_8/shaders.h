@@ -0,0 +1,192 @@
+#ifndef __SHADERS_H__
+#define __SHADERS_H__
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include "geometry.h"
+#include "tgaimage.h"
+#include "texture.h"
+#include "model.h"
+#include "shadowmap.h"
+#include "varyings.h"
+
+// Shaders du rastériseur logiciel. Il n'y a pas de classe de base virtuelle : triangle()
+// (rasterizer.h) est un template sur le type du shader, qui doit fournir
+//   Vec3f vertex(int iface, int nthvert)
+//       coordonnées écran du sommet nthvert de la face iface, prépare les varyings
+//   void quad(Vec3f dbar_dx, Vec3f dbar_dy)
+//       dérivées écran des barycentriques du quad 2x2 dont les fragments suivent (niveau de mipmap)
+//   bool fragment(int x, int y, float z, Vec3f bar, TGAColor &color)
+//       couleur du pixel (x, y) de profondeur z, false pour écarter le pixel. bar est corrigé
+//       de la perspective, les varyings s'interpolent linéairement (varyings.h)
+
+// Multiplie les composantes r, g, b d'une couleur par k (a est gardé) et la repasse sur 8 bits par composante
+inline TGAColor scale_color(Color4f color, float k) {
+    return (color * Color4f(k, k, k, 1.f)).pack();
+}
+
+// Niveau de mipmap d'une texture de w x h texels dont les coordonnées varient de duv_dx d'un pixel
+// au suivant en x et de duv_dy en y : log2 du plus grand des deux pas, en texels
+inline float texture_lod(Vec2f duv_dx, Vec2f duv_dy, int w, int h) {
+    float dx = duv_dx.x*w*duv_dx.x*w + duv_dx.y*h*duv_dx.y*h;
+    float dy = duv_dy.x*w*duv_dy.x*w + duv_dy.y*h*duv_dy.y*h;
+    float rho2 = std::max(dx, dy);
+    return rho2 > 0 ? .5f*std::log2(rho2) : 0.f; // aussi 0 si les dérivées ne sont pas finies
+}
+
+// Base commune : sommets écran déjà transformés et coordonnées de texture interpolées
+struct TexturedShader {
+    Model *model;
+    const std::vector<Vec3f> &screen_verts; // coordonnées écran de chaque coin de face (transform_corners)
+    const Texture &texture;
+    Vec3f light_dir;
+    Varyings<2> varying_uv;
+    float lod; // niveau de mipmap du quad en cours
+
+    TexturedShader(Model *m, const std::vector<Vec3f> &verts, const Texture &tex, Vec3f light) :
+        model(m), screen_verts(verts), texture(tex), light_dir(light), lod(0) {}
+
+    // Le modèle doit avoir son tampon de sommets (Model::build_vertex_buffer)
+    Vec3f vertex(int iface, int nthvert) {
+        // Coordoonnées de la texture vt dans le modele
+        Vec2f tex = model->vertex(model->face_vertices(iface)[nthvert]).uv;
+        varying_uv.set(nthvert, 0, tex.x);
+        varying_uv.set(nthvert, 1, tex.y);
+        return screen_verts[model->face_offset(iface) + nthvert];
+    }
+
+    Vec2f uv(Vec3f bar) const {
+        float uv[2];
+        varying_uv.interpolate(bar, uv);
+        return Vec2f(uv[0], uv[1]);
+    }
+
+    // Les uv sont linéaires en les barycentriques : leurs dérivées s'interpolent comme elles
+    void quad(Vec3f dbar_dx, Vec3f dbar_dy) {
+        lod = texture_lod(uv(dbar_dx), uv(dbar_dy), texture.width(), texture.height());
+    }
+
+    // Lecture trilinéaire d'une image de la taille de la texture diffuse (lod est compté en texels de celle-ci)
+    Color4f sample(const Texture &img, Vec2f uv) {
+        return img.sample(uv.x, uv.y, lod);
+    }
+};
+
+// Une intensité par face, calculée avec la normale géométrique du triangle
+struct FlatShader : TexturedShader {
+    Vec3f world[3];
+    float intensity;
+
+    FlatShader(Model *m, const std::vector<Vec3f> &verts, const Texture &tex, Vec3f light) :
+        TexturedShader(m, verts, tex, light), intensity(0) {}
+
+    Vec3f vertex(int iface, int nthvert) {
+        world[nthvert] = model->vert(model->face(iface)[nthvert]);
+        if (nthvert == 2) {
+            Vec3f n = (world[1] - world[0]) ^ (world[2] - world[0]);
+            intensity = std::max(0.f, n.normalize() * light_dir);
+        }
+        return TexturedShader::vertex(iface, nthvert);
+    }
+
+    bool fragment(int x, int y, float z, Vec3f bar, TGAColor &color) {
+        color = scale_color(sample(texture, uv(bar)), intensity);
+        return true;
+    }
+};
+
+// Intensité calculée aux sommets avec les normales vn du modèle puis interpolée
+struct GouraudShader : TexturedShader {
+    Varyings<1> varying_intensity;
+
+    GouraudShader(Model *m, const std::vector<Vec3f> &verts, const Texture &tex, Vec3f light) :
+        TexturedShader(m, verts, tex, light) {}
+
+    Vec3f vertex(int iface, int nthvert) {
+        varying_intensity.set(nthvert, 0, model->vertex(model->face_vertices(iface)[nthvert]).normal * light_dir);
+        return TexturedShader::vertex(iface, nthvert);
+    }
+
+    bool fragment(int x, int y, float z, Vec3f bar, TGAColor &color) {
+        float intensity;
+        varying_intensity.interpolate(bar, &intensity);
+        intensity = std::max(0.0f, std::min(1.0f, intensity));
+        color = scale_color(sample(texture, uv(bar)), intensity);
+        return true;
+    }
+};
+
+// Normale lue dans la normal map
+struct NormalMapShader : TexturedShader {
+    const Texture &normale;
+
+    NormalMapShader(Model *m, const std::vector<Vec3f> &verts, const Texture &tex, const Texture &nm, Vec3f light) :
+        TexturedShader(m, verts, tex, light), normale(nm) {}
+
+    // Convertion de la couleur en un vecteur normal
+    Vec3f normal(Vec2f uv) {
+        Color4f color = sample(normale, uv);
+        return Vec3f(
+            (color.r() / 255.0f) * 2 - 1,
+            (color.g() / 255.0f) * 2 - 1,
+            (color.b() / 255.0f) * 2 - 1
+        );
+    }
+
+    bool fragment(int x, int y, float z, Vec3f bar, TGAColor &color) {
+        Vec2f tex_coord = uv(bar);
+        float intensity = std::max(0.0f, std::min(1.0f, normal(tex_coord) * light_dir));
+        color = scale_color(sample(texture, tex_coord), intensity);
+        return true;
+    }
+};
+
+// Normal map et occlusion ambiante
+struct AOShader : NormalMapShader {
+    const Texture &occlusion;
+
+    AOShader(Model *m, const std::vector<Vec3f> &verts, const Texture &tex, const Texture &nm, const Texture &ao, Vec3f light) :
+        NormalMapShader(m, verts, tex, nm, light), occlusion(ao) {}
+
+    // Intensité de la lumière, dans la plage [0, 1]
+    float intensity(Vec2f uv) {
+        float ambient_occlusion = sample(occlusion, uv).r() / 255.0f;
+        float intensity = (normal(uv) * light_dir) + ambient_occlusion;
+        return std::max(0.0f, std::min(1.0f, intensity));
+    }
+
+    bool fragment(int x, int y, float z, Vec3f bar, TGAColor &color) {
+        Vec2f tex_coord = uv(bar);
+        color = scale_color(sample(texture, tex_coord), intensity(tex_coord));
+        return true;
+    }
+};
+
+// Normal map, occlusion ambiante et ombre portée lue dans la carte d'ombre
+struct ShadowShader : AOShader {
+    const ShadowMap &shadow_map;
+    Matrix shadow_matrix; // écran de la caméra -> écran de la lumière
+    float bias;
+    PCFKernel kernel;
+
+    ShadowShader(Model *m, const std::vector<Vec3f> &verts, const Texture &tex, const Texture &nm, const Texture &ao, Vec3f light,
+                 const ShadowMap &shadow, const Matrix &camera_matrix, float shadow_bias, PCFKernel pcf_kernel) :
+        AOShader(m, verts, tex, nm, ao, light), shadow_map(shadow),
+        shadow_matrix(shadow.light_matrix()*camera_matrix.inverse()), bias(shadow_bias), kernel(pcf_kernel) {}
+
+    // Ombrage d'un pixel à partir de ses coordonnées de texture, partagé avec le rendu différé
+    TGAColor shade(int x, int y, float z, Vec2f tex_coord) {
+        float light = intensity(tex_coord);
+        Vec3f p(shadow_matrix*Vec4(Vec3f(x, y, z)));
+        float shadow = 0.3 + 0.7*shadow_map.pcf(p, bias, kernel);
+        return scale_color(sample(texture, tex_coord), light * shadow);
+    }
+
+    bool fragment(int x, int y, float z, Vec3f bar, TGAColor &color) {
+        color = shade(x, y, z, uv(bar));
+        return true;
+    }
+};
+
+#endif //__SHADERS_H__
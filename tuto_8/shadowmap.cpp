@@ -0,0 +1,150 @@
+#include <limits>
+#include <cmath>
+#include "shadowmap.h"
+#include "transform.h"
+#include "tiles.h"
+#include "hiz.h"
+#include "rasterizer.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define SHADOWMAP_SSE 1
+#endif
+
+// Disque de Poisson à 8 points dans le disque unité, étiré à poisson_radius texels
+// (abscisses et ordonnées séparées pour les charger 4 par 4)
+static const float poisson_radius = 2.f;
+alignas(16) static const float poisson_x[8] = {
+    -0.490f*poisson_radius,  0.136f*poisson_radius, -0.239f*poisson_radius,  0.516f*poisson_radius,
+    -0.521f*poisson_radius,  0.337f*poisson_radius, -0.062f*poisson_radius,  0.906f*poisson_radius
+};
+alignas(16) static const float poisson_y[8] = {
+     0.494f*poisson_radius, -0.032f*poisson_radius, -0.633f*poisson_radius,  0.394f*poisson_radius,
+    -0.138f*poisson_radius, -0.822f*poisson_radius,  0.958f*poisson_radius, -0.131f*poisson_radius
+};
+
+ShadowMap::ShadowMap(int size) : size_(size), depth_(size*size), light_matrix_(), model_(NULL), valid_(false) {
+}
+
+static bool same_matrix(const Matrix &a, const Matrix &b) {
+    for (int i=0; i<4; i++)
+        for (int j=0; j<4; j++)
+            if (a[i][j] != b[i][j]) return false;
+    return true;
+}
+
+bool ShadowMap::update(Model *model, const Matrix &light_matrix, int nthreads) {
+    if (valid_ && model == model_ && same_matrix(light_matrix, light_matrix_)) return false;
+    model_ = model;
+    light_matrix_ = light_matrix;
+    valid_ = true;
+
+    std::fill(depth_.begin(), depth_.end(), -std::numeric_limits<float>::max());
+    HiZ hiz(depth_.data(), size_, size_);
+
+    std::vector<Vec3f> light_verts;
+    transform_vertices(light_matrix, model, light_verts);
+    std::vector<TileRect> face_boxes(model->nfaces());
+    for (int i = 0; i < model->nfaces(); i++) {
+        FaceIndices face = model->face(i);
+        Vec3f pts[3] = { light_verts[face[0]], light_verts[face[1]], light_verts[face[2]] };
+        face_boxes[i] = bounding_box(pts);
+    }
+
+    // Passe de profondeur seule depuis la lumière
+    float *zbuffer = depth_.data();
+    const int width = size_;
+    render_tiles(size_, size_, nthreads, face_boxes, [&](int i, const TileRect &clip) {
+        FaceIndices face = model->face(i);
+        Vec3f pts[3] = { light_verts[face[0]], light_verts[face[1]], light_verts[face[2]] };
+        rasterize(pts, clip, hiz, [&](int x, int y, Vec3f bar) {
+            float z = pts[0].z * bar.x + pts[1].z * bar.y + pts[2].z * bar.z;
+            if (zbuffer[x+y*width] < z) {
+                zbuffer[x+y*width] = z;
+                return true;
+            }
+            return false;
+        });
+    });
+    return true;
+}
+
+float ShadowMap::depth(int x, int y) const {
+    if (x<0 || y<0 || x>=size_ || y>=size_) return -std::numeric_limits<float>::max();
+    return depth_[x+y*size_];
+}
+
+// Partie entière inférieure, sans appel à std::floor
+static inline int ifloor(float x) {
+    int i = int(x);
+    return i - (x < i);
+}
+
+#ifdef SHADOWMAP_SSE
+// Nombre de texels parmi 4 pour lesquels ref >= texel (table des bits à 1 du masque
+// de comparaison : popcnt n'est pas disponible sans -mpopcnt)
+static inline int count_lit(__m128 ref, __m128 texels) {
+    static const int bits[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+    return bits[_mm_movemask_ps(_mm_cmpge_ps(ref, texels))];
+}
+#endif
+
+float ShadowMap::pcf(Vec3f p, float bias, PCFKernel kernel) const {
+    float ref = p.z + bias;
+    if (kernel == PCF_1x1) return ref >= depth(ifloor(p.x+.5f), ifloor(p.y+.5f));
+
+    if (kernel == PCF_POISSON) {
+        // Texel le plus proche de chaque point du disque (arrondi au plus proche comme cvtps2dq)
+        bool inside = p.x >= poisson_radius + 1 && p.y >= poisson_radius + 1
+                   && p.x + poisson_radius + 1 < size_ && p.y + poisson_radius + 1 < size_;
+#ifdef SHADOWMAP_SSE
+        if (inside) {
+            __m128 r = _mm_set1_ps(ref);
+            int n = 0;
+            for (int h = 0; h < 8; h += 4) {
+                alignas(16) int xi[4], yi[4];
+                _mm_store_si128((__m128i *)xi, _mm_cvtps_epi32(_mm_add_ps(_mm_set1_ps(p.x), _mm_load_ps(poisson_x + h))));
+                _mm_store_si128((__m128i *)yi, _mm_cvtps_epi32(_mm_add_ps(_mm_set1_ps(p.y), _mm_load_ps(poisson_y + h))));
+                __m128 texels = _mm_set_ps(depth_[xi[3] + yi[3]*size_], depth_[xi[2] + yi[2]*size_],
+                                           depth_[xi[1] + yi[1]*size_], depth_[xi[0] + yi[0]*size_]);
+                n += count_lit(r, texels);
+            }
+            return n / 8.f;
+        }
+#endif
+        int n = 0;
+        for (int i = 0; i < 8; i++)
+            n += ref >= depth(int(std::lrint(p.x + poisson_x[i])), int(std::lrint(p.y + poisson_y[i])));
+        return n / 8.f;
+    }
+
+    // Noyaux carrés : texels entourant p (2x2) ou leur voisinage (4x4)
+    int k = kernel == PCF_2x2 ? 2 : 4;
+    int x0 = ifloor(p.x) - (k/2 - 1);
+    int y0 = ifloor(p.y) - (k/2 - 1);
+    bool inside = x0 >= 0 && y0 >= 0 && x0 + k <= size_ && y0 + k <= size_;
+#ifdef SHADOWMAP_SSE
+    if (inside) {
+        const float *row = &depth_[x0 + y0*size_];
+        __m128 r = _mm_set1_ps(ref);
+        int n;
+        if (k == 2) {
+            // Les deux lignes de 2 texels dans un seul registre (movq accepte une adresse non alignée)
+            __m128i top = _mm_loadl_epi64((const __m128i *)row), bottom = _mm_loadl_epi64((const __m128i *)(row + size_));
+            __m128 texels = _mm_castsi128_ps(_mm_unpacklo_epi64(top, bottom));
+            n = count_lit(r, texels);
+        } else {
+            n = count_lit(r, _mm_loadu_ps(row))
+              + count_lit(r, _mm_loadu_ps(row + size_))
+              + count_lit(r, _mm_loadu_ps(row + 2*size_))
+              + count_lit(r, _mm_loadu_ps(row + 3*size_));
+        }
+        return n / float(k*k);
+    }
+#endif
+    int n = 0;
+    for (int j = 0; j < k; j++)
+        for (int i = 0; i < k; i++)
+            n += ref >= depth(x0 + i, y0 + j);
+    return n / float(k*k);
+}
@@ -0,0 +1,36 @@
+#ifndef __SHADOWMAP_H__
+#define __SHADOWMAP_H__
+
+#include <vector>
+#include "geometry.h"
+#include "model.h"
+
+// Noyau du filtrage PCF (percentage-closer filtering) : nombre et disposition des texels comparés
+enum PCFKernel { PCF_1x1, PCF_2x2, PCF_4x4, PCF_POISSON };
+
+// Carte d'ombre : profondeur de la scène vue depuis la lumière, dans sa propre résolution.
+// Elle n'est recalculée que si la matrice de la lumière ou la géométrie a changé depuis le
+// dernier rendu, le coût des ombres est donc payé une fois par scène et non à chaque image.
+class ShadowMap {
+    int size_;
+    std::vector<float> depth_;
+    Matrix light_matrix_; // monde -> écran de la lumière
+    Model *model_;
+    bool valid_;
+public:
+    ShadowMap(int size);
+    int size() const { return size_; }
+    const Matrix &light_matrix() const { return light_matrix_; }
+    // Rend la carte si nécessaire, renvoie true si elle a été recalculée
+    bool update(Model *model, const Matrix &light_matrix, int nthreads);
+    // A appeler quand les sommets du modèle ont été modifiés
+    void invalidate() { valid_ = false; }
+    // Profondeur vue par la lumière au texel (x, y), la plus lointaine possible hors de la carte
+    float depth(int x, int y) const;
+    // Fraction des texels du noyau qui éclairent p (coordonnées écran de la lumière), 1 ou 0 pour PCF_1x1.
+    // Les comparaisons sont faites 4 texels à la fois en SSE (une ligne du noyau 4x4 par instruction),
+    // avec un repli scalaire au bord de la carte.
+    float pcf(Vec3f p, float bias, PCFKernel kernel) const;
+};
+
+#endif //__SHADOWMAP_H__
@@ -0,0 +1,54 @@
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include "texture.h"
+
+Texture::Texture(const TGAImage &img) : bytespp_(0) {
+    const int levels = img.mip_levels();
+    if (!levels) return;
+    bytespp_ = img.get_bytespp();
+    size_t total = 0;
+    for (int l = 0; l < levels; l++) {
+        widths_.push_back(img.mip_width(l));
+        heights_.push_back(img.mip_height(l));
+        tiles_x_.push_back((widths_[l] + 3) / 4);
+        offsets_.push_back(total);
+        total += (size_t)tiles_x_[l] * ((heights_[l] + 3) / 4) * 16;
+    }
+    texels_.assign(total, 0);
+    for (int l = 0; l < levels; l++) {
+        const unsigned char *src = img.mip_buffer(l);
+        for (int y = 0; y < heights_[l]; y++) {
+            for (int x = 0; x < widths_[l]; x++) {
+                memcpy(&texels_[offsets_[l] + tiled_index(x, y, tiles_x_[l])], src + (x + y*widths_[l])*bytespp_, bytespp_);
+            }
+        }
+    }
+}
+
+// Même calcul que le filtrage bilinéaire de TGAImage, seule l'adresse des texels change.
+// Les quatre composantes d'un texel sont pondérées ensemble, les octets de remplissage valent 0.
+Color4f Texture::bilinear(int level, float u, float v) const {
+    const int w = widths_[level], h = heights_[level];
+    float fx = u*w - .5f, fy = (1.f-v)*h - .5f;
+    int x0 = (int)floorf(fx), y0 = (int)floorf(fy);
+    float tx = fx - x0, ty = fy - y0;
+    int x1 = std::min(std::max(x0+1, 0), w-1), y1 = std::min(std::max(y0+1, 0), h-1);
+    x0 = std::min(std::max(x0, 0), w-1);
+    y0 = std::min(std::max(y0, 0), h-1);
+    const uint32_t *texels = &texels_[offsets_[level]];
+    const int tiles_x = tiles_x_[level];
+    Color4f c00(TGAColor(texels[tiled_index(x0, y0, tiles_x)], 4)), c10(TGAColor(texels[tiled_index(x1, y0, tiles_x)], 4));
+    Color4f c01(TGAColor(texels[tiled_index(x0, y1, tiles_x)], 4)), c11(TGAColor(texels[tiled_index(x1, y1, tiles_x)], 4));
+    return c00*((1-tx)*(1-ty)) + c10*(tx*(1-ty)) + c01*((1-tx)*ty) + c11*(tx*ty);
+}
+
+Color4f Texture::sample(float u, float v, float lod) const {
+    if (texels_.empty()) return Color4f();
+    int last = levels() - 1;
+    lod = std::min(std::max(lod, 0.f), (float)last);
+    int level = std::min((int)lod, last);
+    float t = lod - level;
+    if (t <= 0 || level == last) return bilinear(level, u, v);
+    return bilinear(level, u, v)*(1.f-t) + bilinear(level+1, u, v)*t;
+}
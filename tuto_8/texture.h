@@ -0,0 +1,40 @@
+#ifndef __TEXTURE_H__
+#define __TEXTURE_H__
+
+#include <vector>
+#include <cstdint>
+#include "tgaimage.h"
+
+// Texture en lecture seule pour l'échantillonnage, construite à partir d'une TGAImage et de sa chaîne
+// de mipmaps. Les texels sont rangés par tuiles de 4x4, chaque texel sur 4 octets : une tuile occupe
+// exactement une ligne de cache de 64 octets. Un parcours en diagonale de l'espace uv ou les 2x2 texels
+// du filtrage bilinéaire restent le plus souvent dans la même ligne, alors qu'en ordre ligne par ligne
+// chaque pas vertical en touche une nouvelle.
+class Texture {
+    std::vector<uint32_t> texels_;   // tous les niveaux, tuile après tuile
+    std::vector<size_t> offsets_;    // début de chaque niveau dans texels_
+    std::vector<int> widths_, heights_, tiles_x_;
+    int bytespp_;
+
+    // Position du texel (x, y) dans son niveau : tuile puis ligne et colonne dans la tuile
+    static int tiled_index(int x, int y, int tiles_x) {
+        return ((y >> 2)*tiles_x + (x >> 2))*16 + ((y & 3) << 2) + (x & 3);
+    }
+    Color4f bilinear(int level, float u, float v) const;
+public:
+    Texture() : bytespp_(0) {}
+    explicit Texture(const TGAImage &img);
+    int width() const { return widths_.empty() ? 0 : widths_[0]; }
+    int height() const { return heights_.empty() ? 0 : heights_[0]; }
+    int levels() const { return (int)widths_.size(); }
+    // Texel (x, y) du niveau level, couleur nulle hors de l'image comme TGAImage::get
+    TGAColor get(int x, int y, int level = 0) const {
+        if (level >= levels() || x < 0 || y < 0 || x >= widths_[level] || y >= heights_[level]) return TGAColor();
+        return TGAColor(texels_[offsets_[level] + tiled_index(x, y, tiles_x_[level])], bytespp_);
+    }
+    // Filtrage trilinéaire, mêmes conventions que TGAImage::sample, le résultat reste en flottants
+    // (Color4f::pack arrondit comme TGAImage::sample)
+    Color4f sample(float u, float v, float lod) const;
+};
+
+#endif //__TEXTURE_H__
@@ -3,6 +3,7 @@
 #include <string.h>
 #include <time.h>
 #include <math.h>
+#include <algorithm>
 #include "tgaimage.h"
 
 TGAImage::TGAImage() : data(NULL), width(0), height(0), bytespp(0) {
@@ -21,6 +22,8 @@ TGAImage::TGAImage(const TGAImage &img) {
 	unsigned long nbytes = width*height*bytespp;
 	data = new unsigned char[nbytes];
 	memcpy(data, img.data, nbytes);
+	mips = img.mips;
+	mip_offsets = img.mip_offsets;
 }
 
 TGAImage::~TGAImage() {
@@ -36,6 +39,8 @@ TGAImage & TGAImage::operator =(const TGAImage &img) {
 		unsigned long nbytes = width*height*bytespp;
 		data = new unsigned char[nbytes];
 		memcpy(data, img.data, nbytes);
+		mips = img.mips;
+		mip_offsets = img.mip_offsets;
 	}
 	return *this;
 }
@@ -43,6 +48,8 @@ TGAImage & TGAImage::operator =(const TGAImage &img) {
 bool TGAImage::read_tga_file(const char *filename) {
 	if (data) delete [] data;
 	data = NULL;
+	mips.clear();
+	mip_offsets.clear();
 	std::ifstream in;
 	in.open (filename, std::ios::binary);
 	if (!in.is_open()) {
@@ -263,7 +270,7 @@ bool TGAImage::set(int x, int y, TGAColor c) {
 	return true;
 }
 
-int TGAImage::get_bytespp() {
+int TGAImage::get_bytespp() const {
 	return bytespp;
 }
 
@@ -277,6 +284,8 @@ int TGAImage::get_height() {
 
 bool TGAImage::flip_horizontally() {
 	if (!data) return false;
+	mips.clear();
+	mip_offsets.clear();
 	int half = width>>1;
 	for (int i=0; i<half; i++) {
 		for (int j=0; j<height; j++) {
@@ -291,6 +300,8 @@ bool TGAImage::flip_horizontally() {
 
 bool TGAImage::flip_vertically() {
 	if (!data) return false;
+	mips.clear();
+	mip_offsets.clear();
 	unsigned long bytes_per_line = width*bytespp;
 	unsigned char *line = new unsigned char[bytes_per_line];
 	int half = height>>1;
@@ -315,6 +326,8 @@ void TGAImage::clear() {
 
 bool TGAImage::scale(int w, int h) {
 	if (w<=0 || h<=0 || !data) return false;
+	mips.clear();
+	mip_offsets.clear();
 	unsigned char *tdata = new unsigned char[w*h*bytespp];
 	int nscanline = 0;
 	int oscanline = 0;
@@ -350,3 +363,88 @@ bool TGAImage::scale(int w, int h) {
 	return true;
 }
 
+
+void TGAImage::generate_mipmaps() {
+	mips.clear();
+	mip_offsets.clear();
+	if (!data) return;
+	unsigned long total = 0;
+	for (int w=width, h=height; w>1 || h>1; ) {
+		w = std::max(1, w>>1);
+		h = std::max(1, h>>1);
+		mip_offsets.push_back(total);
+		total += (unsigned long)w*h*bytespp;
+	}
+	mips.resize(total);
+	const unsigned char *src = data;
+	int sw = width, sh = height;
+	for (size_t l=0; l<mip_offsets.size(); l++) {
+		unsigned char *dst = &mips[mip_offsets[l]];
+		int w = std::max(1, sw>>1), h = std::max(1, sh>>1);
+		for (int j=0; j<h; j++) {
+			// Sur une dimension impaire ou de 1 pixel, les deux lignes (colonnes) sources sont confondues
+			const unsigned char *r0 = src + std::min(2*j, sh-1)*sw*bytespp;
+			const unsigned char *r1 = src + std::min(2*j+1, sh-1)*sw*bytespp;
+			for (int i=0; i<w; i++) {
+				int i0 = std::min(2*i, sw-1)*bytespp, i1 = std::min(2*i+1, sw-1)*bytespp;
+				for (int c=0; c<bytespp; c++) {
+					dst[(i+j*w)*bytespp+c] = (r0[i0+c] + r0[i1+c] + r1[i0+c] + r1[i1+c] + 2) >> 2;
+				}
+			}
+		}
+		src = dst;
+		sw = w;
+		sh = h;
+	}
+}
+
+int TGAImage::mip_levels() const {
+	return data ? 1 + (int)mip_offsets.size() : 0;
+}
+
+const unsigned char *TGAImage::mip_buffer(int level) const {
+	return level ? &mips[mip_offsets[level-1]] : data;
+}
+
+int TGAImage::mip_width(int level) const {
+	return std::max(1, width>>level);
+}
+
+int TGAImage::mip_height(int level) const {
+	return std::max(1, height>>level);
+}
+
+// Filtrage bilinéaire dans le niveau level, accumulé avec le poids weight dans acc
+static void bilinear(const unsigned char *texels, int w, int h, int bytespp, float u, float v, float weight, float *acc) {
+	float fx = u*w - .5f, fy = (1.f-v)*h - .5f;
+	int x0 = (int)floorf(fx), y0 = (int)floorf(fy);
+	float tx = fx - x0, ty = fy - y0;
+	int x1 = std::min(std::max(x0+1, 0), w-1), y1 = std::min(std::max(y0+1, 0), h-1);
+	x0 = std::min(std::max(x0, 0), w-1);
+	y0 = std::min(std::max(y0, 0), h-1);
+	const unsigned char *p00 = texels + (x0+y0*w)*bytespp, *p10 = texels + (x1+y0*w)*bytespp;
+	const unsigned char *p01 = texels + (x0+y1*w)*bytespp, *p11 = texels + (x1+y1*w)*bytespp;
+	float w00 = (1-tx)*(1-ty)*weight, w10 = tx*(1-ty)*weight, w01 = (1-tx)*ty*weight, w11 = tx*ty*weight;
+	for (int c=0; c<bytespp; c++) {
+		acc[c] += w00*p00[c] + w10*p10[c] + w01*p01[c] + w11*p11[c];
+	}
+}
+
+TGAColor TGAImage::sample(float u, float v, float lod) const {
+	if (!data) return TGAColor();
+	float acc[4] = { 0, 0, 0, 0 };
+	int last = (int)mip_offsets.size();
+	lod = std::min(std::max(lod, 0.f), (float)last);
+	int level = std::min((int)lod, last);
+	float t = lod - level;
+	for (int l=level; l<=std::min(level+1, last); l++) {
+		float weight = l==level ? 1.f-t : t;
+		if (weight<=0) continue;
+		bilinear(mip_buffer(l), mip_width(l), mip_height(l), bytespp, u, v, weight, acc);
+	}
+	TGAColor c(0, bytespp);
+	for (int i=0; i<bytespp; i++) {
+		c.raw[i] = (unsigned char)std::min(255.f, acc[i] + .5f);
+	}
+	return c;
+}
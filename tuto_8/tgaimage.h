@@ -2,6 +2,14 @@
 #define __IMAGE_H__
 
 #include <fstream>
+#include <vector>
+#include <cassert>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define TGAIMAGE_SSE 1
+#endif
 
 #pragma pack(push,1)
 struct TGA_Header {
@@ -22,6 +30,8 @@ struct TGA_Header {
 
 
 
+// Couleur tassée sur 4 octets, dans l'ordre des pixels TGA (b, g, r, a) quel que soit le format de
+// l'image : TGAImage ne lit et n'écrit que ses bytespp premiers octets, les autres restent à 0.
 struct TGAColor {
 	union {
 		struct {
@@ -30,33 +40,96 @@ struct TGAColor {
 		unsigned char raw[4];
 		unsigned int val;
 	};
-	int bytespp;
-
-	TGAColor() : val(0), bytespp(1) {
-	}
 
-	TGAColor(unsigned char R, unsigned char G, unsigned char B, unsigned char A) : b(B), g(G), r(R), a(A), bytespp(4) {
+	TGAColor() : val(0) {
 	}
 
-	TGAColor(int v, int bpp) : val(v), bytespp(bpp) {
+	TGAColor(unsigned char R, unsigned char G, unsigned char B, unsigned char A) : b(B), g(G), r(R), a(A) {
 	}
 
-	TGAColor(const TGAColor &c) : val(c.val), bytespp(c.bytespp) {
+	TGAColor(int v, int bpp) : val(bpp<4 ? v & ((1u<<(8*bpp))-1) : v) {
 	}
 
-	TGAColor(const unsigned char *p, int bpp) : val(0), bytespp(bpp) {
+	TGAColor(const unsigned char *p, int bpp) : val(0) {
 		for (int i=0; i<bpp; i++) {
 			raw[i] = p[i];
 		}
 	}
+};
+
+static_assert(sizeof(TGAColor) == 4, "TGAColor doit tenir dans un mot de 32 bits");
+
+// Couleur en flottants pour les calculs d'ombrage : une composante par voie SSE, dans l'ordre de TGAColor,
+// de 0 à 255. On ne repasse en TGAColor qu'une fois par pixel, arrondi au plus proche et saturé.
+// Sans SSE2, les quatre composantes sont dans un tableau et donnent les mêmes résultats.
+struct Color4f {
+#ifdef TGAIMAGE_SSE
+	__m128 v;
+
+	Color4f() : v(_mm_setzero_ps()) {
+	}
+
+	explicit Color4f(__m128 x) : v(x) {
+	}
+
+	Color4f(float b, float g, float r, float a) : v(_mm_setr_ps(b, g, r, a)) {
+	}
+
+	explicit Color4f(TGAColor c) {
+		__m128i zero = _mm_setzero_si128();
+		__m128i bytes = _mm_cvtsi32_si128((int)c.val);
+		v = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(bytes, zero), zero));
+	}
 
-	TGAColor & operator =(const TGAColor &c) {
-		if (this != &c) {
-			bytespp = c.bytespp;
-			val = c.val;
+	float b() const { return _mm_cvtss_f32(v); }
+	float g() const { return _mm_cvtss_f32(_mm_shuffle_ps(v, v, 1)); }
+	float r() const { return _mm_cvtss_f32(_mm_shuffle_ps(v, v, 2)); }
+	float a() const { return _mm_cvtss_f32(_mm_shuffle_ps(v, v, 3)); }
+
+	Color4f operator +(const Color4f &c) const { return Color4f(_mm_add_ps(v, c.v)); }
+	Color4f operator *(const Color4f &c) const { return Color4f(_mm_mul_ps(v, c.v)); }
+	Color4f operator *(float k) const { return Color4f(_mm_mul_ps(v, _mm_set1_ps(k))); }
+
+	// Les composantes sont positives : +0.5 puis troncature arrondit au plus proche,
+	// les paquetages saturent à [0, 255]
+	TGAColor pack() const {
+		__m128i i = _mm_cvttps_epi32(_mm_add_ps(v, _mm_set1_ps(.5f)));
+		i = _mm_packus_epi16(_mm_packs_epi32(i, i), _mm_setzero_si128());
+		TGAColor c;
+		c.val = (unsigned int)_mm_cvtsi128_si32(i);
+		return c;
+	}
+#else
+	float v[4];
+
+	Color4f() : v{0.f, 0.f, 0.f, 0.f} {
+	}
+
+	Color4f(float b, float g, float r, float a) : v{b, g, r, a} {
+	}
+
+	explicit Color4f(TGAColor c) : v{float(c.b), float(c.g), float(c.r), float(c.a)} {
+	}
+
+	float b() const { return v[0]; }
+	float g() const { return v[1]; }
+	float r() const { return v[2]; }
+	float a() const { return v[3]; }
+
+	Color4f operator +(const Color4f &c) const { return Color4f(v[0]+c.v[0], v[1]+c.v[1], v[2]+c.v[2], v[3]+c.v[3]); }
+	Color4f operator *(const Color4f &c) const { return Color4f(v[0]*c.v[0], v[1]*c.v[1], v[2]*c.v[2], v[3]*c.v[3]); }
+	Color4f operator *(float k) const { return Color4f(v[0]*k, v[1]*k, v[2]*k, v[3]*k); }
+
+	// Même arrondi et même saturation que le chemin SSE
+	TGAColor pack() const {
+		TGAColor c;
+		for (int i=0; i<4; i++) {
+			int x = int(v[i] + .5f);
+			c.raw[i] = (unsigned char)(x < 0 ? 0 : x > 255 ? 255 : x);
 		}
-		return *this;
+		return c;
 	}
+#endif
 };
 
 
@@ -66,6 +139,8 @@ protected:
 	int width;
 	int height;
 	int bytespp;
+	std::vector<unsigned char> mips;        // niveaux 1, 2... de la chaîne de mipmaps, les uns à la suite des autres
+	std::vector<unsigned long> mip_offsets; // début du niveau l+1 dans mips
 
 	bool   load_rle_data(std::ifstream &in);
 	bool unload_rle_data(std::ofstream &out);
@@ -88,9 +163,44 @@ public:
 	TGAImage & operator =(const TGAImage &img);
 	int get_width();
 	int get_height();
-	int get_bytespp();
+	int get_bytespp() const;
 	unsigned char *buffer();
 	void clear();
+
+	// Chaîne de mipmaps : chaque niveau est la moyenne 2x2 du précédent, jusqu'à 1x1 pixel.
+	// Elle est supprimée par read_tga_file, flip_* et scale, à refaire si l'image change.
+	void generate_mipmaps();
+	int mip_levels() const;
+	// Filtrage trilinéaire au point (u, v) de [0,1]^2, v vers le haut comme les coordonnées vt des OBJ.
+	// lod est le log2 du nombre de texels du niveau 0 couverts par un pixel, bilinéaire au niveau 0 si lod <= 0.
+	TGAColor sample(float u, float v, float lod) const;
+	// Texels et dimensions du niveau level de la chaîne (0 : l'image elle-même)
+	const unsigned char *mip_buffer(int level) const;
+	int mip_width(int level) const;
+	int mip_height(int level) const;
+};
+
+// Formats de pixel connus à la compilation, pour ImageView
+struct Gray8 { enum { bytespp = TGAImage::GRAYSCALE }; };
+struct RGB8  { enum { bytespp = TGAImage::RGB }; };
+struct RGBA8 { enum { bytespp = TGAImage::RGBA }; };
+
+// Vue typée sur les pixels d'une TGAImage de format Format, sans copie. Contrairement à TGAImage::get/set,
+// les accès ne vérifient ni les bornes ni l'image : ils sont inlinés et la taille d'un pixel est une
+// constante, set() se réduit à quelques écritures. L'image ne doit pas être réallouée pendant la vie de la vue.
+template <class Format> class ImageView {
+	unsigned char *data;
+	int width;
+	int height;
+public:
+	explicit ImageView(TGAImage &img) : data(img.buffer()), width(img.get_width()), height(img.get_height()) {
+		assert(img.get_bytespp() == Format::bytespp);
+	}
+	int get_width() const { return width; }
+	int get_height() const { return height; }
+	unsigned char *at(int x, int y) const { return data + (x + y*width)*Format::bytespp; }
+	TGAColor get(int x, int y) const { return TGAColor(at(x, y), Format::bytespp); }
+	void set(int x, int y, const TGAColor &c) const { memcpy(at(x, y), c.raw, Format::bytespp); }
 };
 
 #endif //__IMAGE_H__
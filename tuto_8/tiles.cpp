@@ -0,0 +1,51 @@
+#include <algorithm>
+#include <cmath>
+#include <atomic>
+#include <thread>
+#include "tiles.h"
+
+TileRect bounding_box(const Vec3f *pts) {
+    return TileRect(int(std::floor(std::min(pts[0].x, std::min(pts[1].x, pts[2].x)))),
+                    int(std::floor(std::min(pts[0].y, std::min(pts[1].y, pts[2].y)))),
+                    int(std::ceil(std::max(pts[0].x, std::max(pts[1].x, pts[2].x)))),
+                    int(std::ceil(std::max(pts[0].y, std::max(pts[1].y, pts[2].y)))));
+}
+
+void render_tiles(int width, int height, int nthreads, const std::vector<TileRect> &face_boxes,
+                  const std::function<void(int, const TileRect &)> &draw_face) {
+    const int nfaces = (int)face_boxes.size();
+    if (nthreads <= 1) {
+        TileRect screen(0, 0, width-1, height-1);
+        for (int i = 0; i < nfaces; i++)
+            if (!face_boxes[i].empty()) draw_face(i, screen);
+        return;
+    }
+
+    // Binning : les faces sont ajoutées dans l'ordre, chaque tuile garde donc l'ordre de dessin
+    const int tiles_x = (width  + TILE_SIZE - 1) / TILE_SIZE;
+    const int tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+    std::vector<std::vector<int> > bins(tiles_x*tiles_y);
+    for (int i = 0; i < nfaces; i++) {
+        const TileRect &box = face_boxes[i];
+        if (box.empty()) continue;
+        int tx0 = std::max(box.x0, 0) / TILE_SIZE, tx1 = std::min(box.x1, width-1)  / TILE_SIZE;
+        int ty0 = std::max(box.y0, 0) / TILE_SIZE, ty1 = std::min(box.y1, height-1) / TILE_SIZE;
+        for (int ty = ty0; ty <= ty1; ty++)
+            for (int tx = tx0; tx <= tx1; tx++)
+                bins[tx+ty*tiles_x].push_back(i);
+    }
+
+    // Rastérisation : chaque thread prend la prochaine tuile libre
+    std::atomic<int> next_tile(0);
+    auto worker = [&]() {
+        for (int t = next_tile++; t < tiles_x*tiles_y; t = next_tile++) {
+            int tx = t % tiles_x, ty = t / tiles_x;
+            TileRect clip(tx*TILE_SIZE, ty*TILE_SIZE,
+                          std::min((tx+1)*TILE_SIZE, width)-1, std::min((ty+1)*TILE_SIZE, height)-1);
+            for (int face : bins[t]) draw_face(face, clip);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (int i = 0; i < nthreads; i++) pool.push_back(std::thread(worker));
+    for (std::thread &th : pool) th.join();
+}
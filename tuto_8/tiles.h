@@ -0,0 +1,31 @@
+#ifndef __TILES_H__
+#define __TILES_H__
+
+#include <vector>
+#include <functional>
+#include "geometry.h"
+
+// Rectangle de pixels, bornes incluses
+struct TileRect {
+    int x0, y0, x1, y1;
+    TileRect() : x0(0), y0(0), x1(-1), y1(-1) {}
+    TileRect(int _x0, int _y0, int _x1, int _y1) : x0(_x0), y0(_y0), x1(_x1), y1(_y1) {}
+    bool empty() const { return x0 > x1 || y0 > y1; }
+};
+
+// Plus petit rectangle de pixels contenant le triangle pts
+TileRect bounding_box(const Vec3f *pts);
+
+const int TILE_SIZE = 64;
+
+// Rendu par tuiles en deux phases :
+//  - binning : chaque face est rangée dans les tuiles TILE_SIZE x TILE_SIZE que touche sa boîte englobante,
+//  - rastérisation : nthreads threads se partagent les tuiles, chaque tuile (et donc sa part du zbuffer
+//    et de l'image) n'est traitée que par un seul thread, sans verrou.
+// Dans une tuile les faces sont dessinées dans leur ordre d'origine, l'image obtenue est donc identique
+// au bit près à un rendu mono-thread. draw_face(face, clip) doit dessiner la face en se limitant à clip,
+// les faces de boîte vide (écartées avant la rastérisation) ne sont jamais dessinées.
+void render_tiles(int width, int height, int nthreads, const std::vector<TileRect> &face_boxes,
+                  const std::function<void(int, const TileRect &)> &draw_face);
+
+#endif //__TILES_H__
@@ -0,0 +1,177 @@
+#include "transform.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TRANSFORM_X86 1
+#endif
+
+// Les produits sont faits dans le même ordre que Mat4*Vec4 puis Vec3f(Vec4),
+// ce qui garde les résultats identiques au bit près sur les trois chemins.
+// Sans out_w, le résultat est divisé par w ; avec out_w, les coordonnées homogènes sont rangées telles quelles.
+static void transform_scalar(const Mat4 &m, const float *xs, const float *ys, const float *zs, size_t begin, size_t n,
+                             float *out_x, float *out_y, float *out_z, float *out_w) {
+    for (size_t i = begin; i < n; i++) {
+        float x = m[0][0]*xs[i] + m[0][1]*ys[i] + m[0][2]*zs[i] + m[0][3];
+        float y = m[1][0]*xs[i] + m[1][1]*ys[i] + m[1][2]*zs[i] + m[1][3];
+        float z = m[2][0]*xs[i] + m[2][1]*ys[i] + m[2][2]*zs[i] + m[2][3];
+        float w = m[3][0]*xs[i] + m[3][1]*ys[i] + m[3][2]*zs[i] + m[3][3];
+        if (out_w) {
+            out_x[i] = x;
+            out_y[i] = y;
+            out_z[i] = z;
+            out_w[i] = w;
+            continue;
+        }
+        out_x[i] = x/w;
+        out_y[i] = y/w;
+        out_z[i] = z/w;
+    }
+}
+
+#ifdef TRANSFORM_X86
+static size_t transform_sse(const Mat4 &m, const float *xs, const float *ys, const float *zs, size_t n,
+                            float *out_x, float *out_y, float *out_z, float *out_w) {
+    __m128 c[4][4];
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++)
+            c[i][j] = _mm_set1_ps(m[i][j]);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 x = _mm_loadu_ps(xs + i);
+        __m128 y = _mm_loadu_ps(ys + i);
+        __m128 z = _mm_loadu_ps(zs + i);
+        __m128 r[4];
+        for (int k = 0; k < 4; k++)
+            r[k] = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(c[k][0], x), _mm_mul_ps(c[k][1], y)), _mm_mul_ps(c[k][2], z)), c[k][3]);
+        if (out_w) {
+            _mm_storeu_ps(out_x + i, r[0]);
+            _mm_storeu_ps(out_y + i, r[1]);
+            _mm_storeu_ps(out_z + i, r[2]);
+            _mm_storeu_ps(out_w + i, r[3]);
+            continue;
+        }
+        _mm_storeu_ps(out_x + i, _mm_div_ps(r[0], r[3]));
+        _mm_storeu_ps(out_y + i, _mm_div_ps(r[1], r[3]));
+        _mm_storeu_ps(out_z + i, _mm_div_ps(r[2], r[3]));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t transform_avx2(const Mat4 &m, const float *xs, const float *ys, const float *zs, size_t n,
+                             float *out_x, float *out_y, float *out_z, float *out_w) {
+    __m256 c[4][4];
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++)
+            c[i][j] = _mm256_set1_ps(m[i][j]);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 x = _mm256_loadu_ps(xs + i);
+        __m256 y = _mm256_loadu_ps(ys + i);
+        __m256 z = _mm256_loadu_ps(zs + i);
+        __m256 r[4];
+        for (int k = 0; k < 4; k++)
+            r[k] = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(c[k][0], x), _mm256_mul_ps(c[k][1], y)), _mm256_mul_ps(c[k][2], z)), c[k][3]);
+        if (out_w) {
+            _mm256_storeu_ps(out_x + i, r[0]);
+            _mm256_storeu_ps(out_y + i, r[1]);
+            _mm256_storeu_ps(out_z + i, r[2]);
+            _mm256_storeu_ps(out_w + i, r[3]);
+            continue;
+        }
+        _mm256_storeu_ps(out_x + i, _mm256_div_ps(r[0], r[3]));
+        _mm256_storeu_ps(out_y + i, _mm256_div_ps(r[1], r[3]));
+        _mm256_storeu_ps(out_z + i, _mm256_div_ps(r[2], r[3]));
+    }
+    return i;
+}
+#endif
+
+enum TransformPath { PATH_SCALAR, PATH_SSE, PATH_AVX2 };
+
+static TransformPath detect_path() {
+#ifdef TRANSFORM_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return PATH_AVX2;
+    if (__builtin_cpu_supports("sse"))  return PATH_SSE;
+#endif
+    return PATH_SCALAR;
+}
+
+static const TransformPath path = detect_path();
+
+const char *transform_vertices_path() {
+    switch (path) {
+        case PATH_AVX2: return "avx2";
+        case PATH_SSE:  return "sse";
+        default:        return "scalar";
+    }
+}
+
+// Choix du chemin commun aux deux interfaces, out_w nul pour diviser par w
+static void transform_dispatch(const Mat4 &m, const float *xs, const float *ys, const float *zs, size_t n,
+                               float *out_x, float *out_y, float *out_z, float *out_w) {
+    size_t done = 0;
+#ifdef TRANSFORM_X86
+    if (path == PATH_AVX2) done = transform_avx2(m, xs, ys, zs, n, out_x, out_y, out_z, out_w);
+    else if (path == PATH_SSE) done = transform_sse(m, xs, ys, zs, n, out_x, out_y, out_z, out_w);
+#endif
+    // Les derniers sommets (moins d'un paquet) passent par le chemin scalaire
+    transform_scalar(m, xs, ys, zs, done, n, out_x, out_y, out_z, out_w);
+}
+
+void transform_vertices(const Mat4 &m, const float *xs, const float *ys, const float *zs, size_t n,
+                        float *out_x, float *out_y, float *out_z) {
+    transform_dispatch(m, xs, ys, zs, n, out_x, out_y, out_z, NULL);
+}
+
+void transform_homogeneous(const Mat4 &m, const float *xs, const float *ys, const float *zs, size_t n,
+                           float *out_x, float *out_y, float *out_z, float *out_w) {
+    transform_dispatch(m, xs, ys, zs, n, out_x, out_y, out_z, out_w);
+}
+
+void transform_vertices(const Mat4 &m, Model *model, std::vector<Vec3f> &screen_verts) {
+    int n = model->nverts();
+    std::vector<float> xs(n), ys(n), zs(n);
+    transform_vertices(m, model->verts_x(), model->verts_y(), model->verts_z(), n, xs.data(), ys.data(), zs.data());
+    screen_verts.resize(n);
+    for (int i = 0; i < n; i++) {
+        screen_verts[i] = Vec3f(xs[i], ys[i], zs[i]);
+    }
+}
+
+long transform_corners(const Mat4 &m, const Model *model, const std::vector<bool> &face_visible,
+                       std::vector<ClipVertex> &corners) {
+    // Positions utilisées par les faces visibles, rangées à la suite dans l'ordre de première utilisation
+    const float *vx = model->verts_x(), *vy = model->verts_y(), *vz = model->verts_z();
+    std::vector<int> slot(model->nverts(), -1);
+    std::vector<float> xs, ys, zs;
+    for (int f = 0; f < model->nfaces(); f++) {
+        if (!face_visible[f]) continue;
+        for (int v : model->face(f)) {
+            if (slot[v] >= 0) continue;
+            slot[v] = (int)xs.size();
+            xs.push_back(vx[v]);
+            ys.push_back(vy[v]);
+            zs.push_back(vz[v]);
+        }
+    }
+    const size_t n = xs.size();
+    std::vector<float> out_x(n), out_y(n), out_z(n), out_w(n);
+    transform_homogeneous(m, xs.data(), ys.data(), zs.data(), n, out_x.data(), out_y.data(), out_z.data(), out_w.data());
+
+    corners.resize(model->ncorners());
+    for (int f = 0; f < model->nfaces(); f++) {
+        if (!face_visible[f]) continue;
+        FaceIndices face = model->face(f);
+        for (int k = 0; k < face.size(); k++) {
+            int i = slot[face[k]];
+            ClipVertex &out = corners[model->face_offset(f) + k];
+            out.x = out_x[i];
+            out.y = out_y[i];
+            out.z = out_z[i];
+            out.w = out_w[i];
+        }
+    }
+    return (long)n;
+}
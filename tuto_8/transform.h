@@ -0,0 +1,35 @@
+#ifndef __TRANSFORM_H__
+#define __TRANSFORM_H__
+
+#include <cstddef>
+#include <vector>
+#include "geometry.h"
+#include "model.h"
+#include "clip.h"
+
+// Transforme n sommets stockés en structure de tableaux (xs, ys, zs) par la matrice m
+// et applique la division perspective dans la même passe.
+// Le chemin SSE (4 sommets) ou AVX2 (8 sommets) est choisi à l'exécution via CPUID,
+// avec un repli scalaire ; les trois chemins donnent exactement les mêmes résultats.
+void transform_vertices(const Mat4 &m, const float *xs, const float *ys, const float *zs, size_t n,
+                        float *out_x, float *out_y, float *out_z);
+
+// Etape de transformation : on applique la matrice m à tous les sommets du modèle d'un coup
+void transform_vertices(const Mat4 &m, Model *model, std::vector<Vec3f> &screen_verts);
+
+// Même calcul sans division perspective : coordonnées homogènes (x, y, z, w) de chaque sommet
+void transform_homogeneous(const Mat4 &m, const float *xs, const float *ys, const float *zs, size_t n,
+                           float *out_x, float *out_y, float *out_z, float *out_w);
+
+// Etage de sommets : seules les positions utilisées par les faces visibles (face_visible[f] vrai, les
+// meshlets écartés ne coûtent rien ici) sont rassemblées en structure de tableaux et transformées, une
+// seule fois chacune (transform_homogeneous). Leurs coordonnées homogènes (pour l'étage de découpage)
+// sont ensuite recopiées pour chaque coin de face, rangées comme corners[model->face_offset(f) + k].
+// Renvoie le nombre de positions transformées.
+long transform_corners(const Mat4 &m, const Model *model, const std::vector<bool> &face_visible,
+                       std::vector<ClipVertex> &corners);
+
+// Nom du chemin retenu ("avx2", "sse" ou "scalar")
+const char *transform_vertices_path();
+
+#endif //__TRANSFORM_H__
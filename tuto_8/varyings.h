@@ -0,0 +1,20 @@
+#ifndef __VARYINGS_H__
+#define __VARYINGS_H__
+
+// Varyings d'un triangle : N flottants par sommet, écrits par vertex() et interpolés pour chaque pixel.
+// Les barycentriques reçues par fragment() sont déjà corrigées de la perspective par rasterize_face
+// (une seule inversion par pixel, partagée par tous les varyings), l'interpolation est donc linéaire.
+// Rangement en structure de tableaux : value[k] contient l'attribut k aux trois sommets, la boucle
+// sur les attributs se vectorise.
+template <int N> struct Varyings {
+    float value[N][3];
+
+    void set(int nthvert, int k, float v) { value[k][nthvert] = v; }
+
+    void interpolate(Vec3f bar, float *out) const {
+        for (int k = 0; k < N; k++)
+            out[k] = value[k][0] * bar.x + value[k][1] * bar.y + value[k][2] * bar.z;
+    }
+};
+
+#endif //__VARYINGS_H__